@@ -36,11 +36,18 @@ namespace
 	// directory that is being monitored, and a helper structure for use with
 	// the Windows Overlapped I/O subsystems.
 	//
+	// Two buffers are kept so that the next overlapped read can be handed to
+	// the OS before the previous batch of notifications is decoded. This way
+	// the kernel keeps filling one buffer while the callbacks are running on
+	// the contents of the other, and activity arriving in the meantime is not
+	// lost to a buffer overflow.
+	//
 	struct WatchedPath
 	{
 		std::wstring Path;
 		FileWatchCallback Callback;
-		std::vector<char> Buffer;
+		std::vector<char> Buffers[2];
+		unsigned ActiveBuffer;
 		HANDLE Directory;
 		OVERLAPPED Overlapped;
 	};
@@ -51,6 +58,36 @@ namespace
 	std::list<WatchedPath> WatchedPaths;
 
 
+	// Forward declarations
+	void WINAPI FileWatchCompletionRoutine(DWORD error, DWORD bytes, LPOVERLAPPED overlapped);
+
+
+	//
+	// Helper for issuing an overlapped read into the active buffer of a watched path
+	//
+	bool BeginDirectoryRead(WatchedPath& wp)
+	{
+		std::vector<char>& buffer = wp.Buffers[wp.ActiveBuffer];
+		return (::ReadDirectoryChangesW(wp.Directory, &buffer[0], static_cast<DWORD>(buffer.size()), TRUE, NotificationFilter, NULL, &wp.Overlapped, FileWatchCompletionRoutine) != 0);
+	}
+
+	//
+	// Helper for shutting down the monitor on a single watched path
+	//
+	void StopWatching(WatchedPath& wp)
+	{
+		for(std::list<WatchedPath>::iterator iter = WatchedPaths.begin(); iter != WatchedPaths.end(); ++iter)
+		{
+			if(&(*iter) == &wp)
+			{
+				::CloseHandle(wp.Directory);
+				WatchedPaths.erase(iter);
+				break;
+			}
+		}
+	}
+
+
 	//
 	// I/O completion routine for handling file monitoring callbacks
 	//
@@ -71,12 +108,24 @@ namespace
 		if(error || !bytes)
 			return;
 
+		WatchedPath& wp = *reinterpret_cast<WatchedPath*>(overlapped->hEvent);
+
 		//
-		// Parse out the notification details provided
+		// Re-arm the monitor on the spare buffer before doing any decoding
 		//
-		WatchedPath& wp = *reinterpret_cast<WatchedPath*>(overlapped->hEvent);
+		// The completed buffer is left untouched by the OS until we hand it back
+		// on the next completion, so it is safe to parse it while the new read is
+		// outstanding. If re-arming fails we still deliver what we already have,
+		// and then silently shut down the monitor for this path.
+		//
+		std::vector<char>& completed = wp.Buffers[wp.ActiveBuffer];
+		wp.ActiveBuffer ^= 1;
+		bool rearmed = BeginDirectoryRead(wp);
 
-		FILE_NOTIFY_INFORMATION* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(&wp.Buffer[0]);
+		//
+		// Parse out the notification details provided
+		//
+		FILE_NOTIFY_INFORMATION* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(&completed[0]);
 		while(true)
 		{
 			// The provided path strings are Unicode and NOT null-terminated,
@@ -112,20 +161,8 @@ namespace
 			info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(reinterpret_cast<char*>(info) + info->NextEntryOffset);
 		}
 
-		// Reset the monitor to detect additional activity in the future
-		if(!::ReadDirectoryChangesW(wp.Directory, &wp.Buffer[0], static_cast<DWORD>(wp.Buffer.size()), TRUE, NotificationFilter, NULL, &wp.Overlapped, FileWatchCompletionRoutine))
-		{
-			// If something went wrong, silently shut down the monitor for this path
-			for(std::list<WatchedPath>::iterator iter = WatchedPaths.begin(); iter != WatchedPaths.end(); ++iter)
-			{
-				if(&(*iter) == &wp)
-				{
-					::CloseHandle(wp.Directory);
-					WatchedPaths.erase(iter);
-					break;
-				}
-			}
-		}
+		if(!rearmed)
+			StopWatching(wp);
 	}
 
 }
@@ -175,11 +212,17 @@ namespace FileWatchImpl
 			if(ret == WAIT_OBJECT_0)
 			{
 				// If the wake event was signalled, it's because we have new
-				// commands to process. Lock the critical section and have a
-				// look at what we need to do.
-				Threads::CriticalSection::Auto lock(CommandCritSec);
+				// commands to process. Take the whole pending batch in one go
+				// so that the critical section is only held for a list splice,
+				// and callers of WatchPath() never wait on our CreateFile() or
+				// ReadDirectoryChangesW() calls.
+				std::list<Command> pending;
+				{
+					Threads::CriticalSection::Auto lock(CommandCritSec);
+					pending.splice(pending.end(), Commands);
+				}
 
-				for(std::list<Command>::const_iterator iter = Commands.begin(); iter != Commands.end(); ++iter)
+				for(std::list<Command>::const_iterator iter = pending.begin(); iter != pending.end(); ++iter)
 				{
 					switch(iter->WhichCommand)
 					{
@@ -194,12 +237,17 @@ namespace FileWatchImpl
 							WatchedPath& wp = WatchedPaths.back();
 							wp.Path = iter->Path;
 							wp.Callback = iter->Callback;
-							wp.Buffer.resize(10000);		// Arbitrary, but needs to be large in case of high activity
+							wp.Buffers[0].resize(10000);	// Arbitrary, but needs to be large in case of high activity
+							wp.Buffers[1].resize(10000);
+							wp.ActiveBuffer = 0;
 							wp.Overlapped.hEvent = &wp;
 							wp.Directory = directory;
 
-							if(!::ReadDirectoryChangesW(directory, &wp.Buffer[0], static_cast<DWORD>(wp.Buffer.size()), TRUE, NotificationFilter, NULL, &wp.Overlapped, FileWatchCompletionRoutine))
+							if(!BeginDirectoryRead(wp))
+							{
+								::CloseHandle(directory);
 								WatchedPaths.pop_back();
+							}
 						}
 						break;
 
@@ -208,15 +256,15 @@ namespace FileWatchImpl
 						for(std::list<WatchedPath>::const_iterator iter = WatchedPaths.begin(); iter != WatchedPaths.end(); ++iter)
 							::CloseHandle(iter->Directory);
 
-						::CloseHandle(WakeEvent);
-						WakeEvent = INVALID_HANDLE_VALUE;
+						{
+							Threads::CriticalSection::Auto lock(CommandCritSec);
+							::CloseHandle(WakeEvent);
+							WakeEvent = INVALID_HANDLE_VALUE;
+						}
 						running = false;
 						break;
 					}
 				}
-
-				// We've processed everything, so clear the command queue
-				Commands.clear();
 			}
 		}
 
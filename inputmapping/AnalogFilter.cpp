@@ -0,0 +1,152 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Chains of filters applied to converted range values (deadzones, curves, etc.)
+//
+
+#include "pch.h"
+
+#include "AnalogFilter.h"
+
+#include <cmath>
+#include <stdexcept>
+
+
+using namespace InputMapping;
+
+
+//
+// Construct an empty filter chain, which passes values through untouched
+//
+AnalogFilterChain::AnalogFilterChain()
+	: StageCount(0)
+{
+}
+
+
+//
+// Append a stage to the end of the chain
+//
+// Curve stages have their lookup tables built here, so that applying
+// the curve at runtime costs an interpolated table read.
+//
+void AnalogFilterChain::AddStage(AnalogFilterType type, double parameter)
+{
+	if(StageCount >= AnalogFilterState::MaxStages)
+		throw std::runtime_error("Too many filter stages specified for a single range");
+
+	switch(type)
+	{
+	case ANALOG_FILTER_DEADZONE:
+		if(parameter < 0.0 || parameter >= 1.0)
+			throw std::runtime_error("Deadzone filter must be in the range [0, 1)");
+		break;
+
+	case ANALOG_FILTER_CURVE:
+		if(parameter <= 0.0)
+			throw std::runtime_error("Curve filter exponent must be positive");
+		break;
+
+	case ANALOG_FILTER_SMOOTHING:
+		if(parameter < 0.0 || parameter >= 1.0)
+			throw std::runtime_error("Smoothing filter must be in the range [0, 1)");
+		break;
+
+	case ANALOG_FILTER_ACCELERATION:
+		break;
+
+	default:
+		throw std::runtime_error("Invalid filter type specified");
+	}
+
+	Stage& stage = Stages[StageCount++];
+	stage.Type = type;
+	stage.Parameter = parameter;
+	stage.CurveTableOffset = static_cast<unsigned>(CurveTables.size());
+
+	if(type == ANALOG_FILTER_CURVE)
+	{
+		for(unsigned i = 0; i <= CurveTableSize; ++i)
+			CurveTables.push_back(std::pow(static_cast<double>(i) / CurveTableSize, parameter));
+	}
+}
+
+
+//
+// Run a value through every stage of the chain
+//
+double AnalogFilterChain::Apply(double value, AnalogFilterState& state) const
+{
+	for(unsigned i = 0; i < StageCount; ++i)
+	{
+		const Stage& stage = Stages[i];
+		double magnitude = std::fabs(value);
+		double sign = (value < 0.0) ? -1.0 : 1.0;
+
+		switch(stage.Type)
+		{
+		case ANALOG_FILTER_DEADZONE:
+			if(magnitude < stage.Parameter)
+				value = 0.0;
+			else
+				value = sign * (magnitude - stage.Parameter) / (1.0 - stage.Parameter);
+			break;
+
+		case ANALOG_FILTER_CURVE:
+			value = sign * EvaluateCurve(stage, magnitude);
+			break;
+
+		case ANALOG_FILTER_SMOOTHING:
+			value = state.History[i] + (1.0 - stage.Parameter) * (value - state.History[i]);
+			state.History[i] = value;
+			break;
+
+		case ANALOG_FILTER_ACCELERATION:
+			value *= 1.0 + (stage.Parameter * magnitude);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return value;
+}
+
+//
+// Advance the chain's state by a tick on which its range had no input
+//
+// An absent range is at rest, so smoothing eases off towards zero exactly
+// as if it had been fed zeros (every other stage maps zero to zero), rather
+// than holding on to a stale value to smooth the range's next input with.
+//
+void AnalogFilterChain::Rest(AnalogFilterState& state) const
+{
+	for(unsigned i = 0; i < StageCount; ++i)
+	{
+		if(Stages[i].Type == ANALOG_FILTER_SMOOTHING)
+			state.History[i] *= Stages[i].Parameter;
+	}
+}
+
+
+//
+// Helper: evaluate a response curve from its lookup table
+//
+// Magnitudes beyond the end of the table are clamped to full deflection.
+//
+double AnalogFilterChain::EvaluateCurve(const Stage& stage, double magnitude) const
+{
+	const double* table = &CurveTables[stage.CurveTableOffset];
+
+	double position = magnitude * CurveTableSize;
+	if(position >= CurveTableSize)
+		return table[CurveTableSize];
+
+	unsigned index = static_cast<unsigned>(position);
+	double fraction = position - index;
+	return table[index] + (fraction * (table[index + 1] - table[index]));
+}
+
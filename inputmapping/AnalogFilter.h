@@ -0,0 +1,108 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Chains of filters applied to converted range values (deadzones, curves, etc.)
+//
+
+#pragma once
+
+
+// Dependencies
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	//
+	// Kinds of filter stage which can be applied to a range
+	//
+	// All stages operate on converted values, and so assume that the range
+	// has been normalized to roughly [-1, 1] by its converter. Each type of
+	// stage takes a single parameter:
+	//
+	//  Deadzone		Magnitudes below the parameter snap to zero; the rest of the
+	//					span is rescaled so the response stays continuous
+	//  Curve			Magnitudes are raised to the given exponent, evaluated via a
+	//					lookup table built when the stage is loaded
+	//  Smoothing		Exponential smoothing; the parameter is the fraction of the
+	//					previous output retained each tick, in [0, 1). On ticks
+	//					where the range is absent it decays towards zero
+	//  Acceleration	Values are scaled by (1 + parameter * magnitude)
+	//
+	enum AnalogFilterType
+	{
+		ANALOG_FILTER_DEADZONE,
+		ANALOG_FILTER_CURVE,
+		ANALOG_FILTER_SMOOTHING,
+		ANALOG_FILTER_ACCELERATION,
+
+		ANALOG_FILTER_TYPE_COUNT
+	};
+
+
+	//
+	// Per-range state carried between ticks by stateful filter stages
+	//
+	struct AnalogFilterState
+	{
+		static const unsigned MaxStages = 4;
+
+		double History[MaxStages];
+
+		AnalogFilterState()
+		{
+			for(unsigned i = 0; i < MaxStages; ++i)
+				History[i] = 0.0;
+		}
+	};
+
+
+	//
+	// Ordered sequence of filter stages applied to a single range
+	//
+	class AnalogFilterChain
+	{
+	// Construction
+	public:
+		AnalogFilterChain();
+
+	// Configuration interface
+	public:
+		void AddStage(AnalogFilterType type, double parameter);
+
+		bool IsEmpty() const
+		{ return StageCount == 0; }
+
+	// Filtering interface
+	public:
+		double Apply(double value, AnalogFilterState& state) const;
+		void Rest(AnalogFilterState& state) const;
+
+	// Internal constants
+	private:
+		static const unsigned CurveTableSize = 256;
+
+	// Internal helpers
+	private:
+		struct Stage
+		{
+			AnalogFilterType Type;
+			double Parameter;
+			unsigned CurveTableOffset;
+		};
+
+		double EvaluateCurve(const Stage& stage, double magnitude) const;
+
+	// Internal tracking
+	private:
+		Stage Stages[AnalogFilterState::MaxStages];
+		unsigned StageCount;
+
+		std::vector<double> CurveTables;
+	};
+
+}
+
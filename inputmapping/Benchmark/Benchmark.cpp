@@ -0,0 +1,495 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Benchmark for the input mapper over synthetic raw input
+//
+// Usage: InputMappingBenchmark [--contexts N] [--depth N] [--bindings N]
+//                              [--callbacks N] [--events N] [--frames N]
+//
+// A set of context files is generated in the working directory, the given
+// number of them is pushed onto a mapper, and a fixed pseudo-random stream
+// of button and axis events is fed through it one frame at a time, the way
+// a game would: queue the frame's events, process the queue, dispatch, and
+// clear. The stream is generated up front, so only the mapper is timed.
+//
+
+#include "InputMapper.h"
+#include "ContextLibrary.h"
+#include "InputConstants.h"
+#include "RawInputConstants.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+using namespace InputMapping;
+
+
+//
+// Constants
+//
+namespace
+{
+	const char ContextListFileName[] = "BenchmarkContexts.txt";
+
+	// Share of events which are axis motion rather than button changes
+	const unsigned AxisEventPercent = 25;
+
+	// Frames run before measuring, so first-use allocations are not counted
+	const unsigned WarmupFrames = 100;
+}
+
+
+//
+// Allocation counting
+//
+// Every allocation in the process goes through these replacements, so the
+// number made while frames are being mapped can be reported per frame.
+//
+namespace
+{
+	std::atomic<unsigned long long> AllocationCount(0);
+}
+
+void* operator new(size_t size)
+{
+	AllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* ret = std::malloc(size ? size : 1);
+	if(!ret)
+		throw std::bad_alloc();
+
+	return ret;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+
+//
+// Internal helpers
+//
+namespace
+{
+
+	//
+	// Benchmark configuration, as given on the command line
+	//
+	struct BenchmarkSettings
+	{
+		unsigned ContextCount;
+		unsigned StackDepth;
+		unsigned ModifierBindingCount;
+		unsigned CallbackCount;
+		unsigned EventsPerFrame;
+		unsigned FrameCount;
+	};
+
+
+	//
+	// Hardware cache miss counter for the calling thread, where the platform
+	// offers one; reports itself unavailable otherwise
+	//
+	class CacheMissCounter
+	{
+	public:
+		CacheMissCounter()
+			: Descriptor(-1)
+		{
+#ifdef __linux__
+			perf_event_attr attributes;
+			std::memset(&attributes, 0, sizeof(attributes));
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+			attributes.disabled = 1;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+
+			Descriptor = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+		}
+
+		~CacheMissCounter()
+		{
+#ifdef __linux__
+			if(Descriptor >= 0)
+				close(Descriptor);
+#endif
+		}
+
+		bool IsAvailable() const
+		{ return Descriptor >= 0; }
+
+		void Start()
+		{
+#ifdef __linux__
+			if(Descriptor >= 0)
+			{
+				ioctl(Descriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(Descriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		unsigned long long Stop()
+		{
+			unsigned long long count = 0;
+#ifdef __linux__
+			if(Descriptor >= 0)
+			{
+				ioctl(Descriptor, PERF_EVENT_IOC_DISABLE, 0);
+				if(read(Descriptor, &count, sizeof(count)) != sizeof(count))
+					count = 0;
+			}
+#endif
+			return count;
+		}
+
+	private:
+		int Descriptor;
+	};
+
+
+	//
+	// Small deterministic generator, so every run maps the same stream
+	//
+	class Random
+	{
+	public:
+		explicit Random(unsigned seed)
+			: State(seed)
+		{
+		}
+
+		unsigned Next(unsigned bound)
+		{
+			State = State * 6364136223846793005ull + 1442695040888963407ull;
+			return static_cast<unsigned>((State >> 33) % bound);
+		}
+
+	private:
+		unsigned long long State;
+	};
+
+
+	//
+	// Write a context file and the list naming all of them
+	//
+	// Context N maps every raw button whose number has the same parity as N
+	// (so contexts lower in the stack still see some traffic), alternating
+	// between actions and states, and maps both axes to ranges. Modifier
+	// bindings each require one other button to be held.
+	//
+	void WriteContextFiles(const BenchmarkSettings& settings)
+	{
+		std::ofstream listfile(ContextListFileName);
+		listfile << settings.ContextCount << "\n";
+
+		for(unsigned i = 0; i < settings.ContextCount; ++i)
+		{
+			std::ostringstream filename;
+			filename << "BenchmarkContext" << i << ".txt";
+			listfile << "context" << i << " " << filename.str() << "\n";
+
+			std::vector<unsigned> states;
+			std::vector<unsigned> actions;
+			for(unsigned button = 0; button < RAW_INPUT_BUTTON_COUNT; ++button)
+			{
+				if((button + i) % 2)
+					continue;
+
+				if((button / 2) % 2)
+					states.push_back(button);
+				else
+					actions.push_back(button);
+			}
+
+			std::ofstream contextfile(filename.str().c_str());
+
+			contextfile << RAW_INPUT_AXIS_COUNT << "\n";
+			for(unsigned axis = 0; axis < RAW_INPUT_AXIS_COUNT; ++axis)
+				contextfile << axis << " " << (axis % RANGE_BUILTIN_COUNT) << "\n";
+
+			contextfile << states.size() << "\n";
+			for(size_t j = 0; j < states.size(); ++j)
+				contextfile << states[j] << " " << ((states[j] + i) % STATE_BUILTIN_COUNT) << "\n";
+
+			contextfile << actions.size() << "\n";
+			for(size_t j = 0; j < actions.size(); ++j)
+				contextfile << actions[j] << " " << ((actions[j] + i) % ACTION_BUILTIN_COUNT) << "\n";
+
+			contextfile << RANGE_BUILTIN_COUNT << "\n";
+			for(unsigned range = 0; range < RANGE_BUILTIN_COUNT; ++range)
+				contextfile << range << " -1000 1000 -1 1\n";
+
+			contextfile << "0\n";		// Sensitivities
+			contextfile << "0\n";		// Filter stages
+			contextfile << "0\n";		// Combos
+
+			contextfile << settings.ModifierBindingCount << "\n";
+			for(unsigned j = 0; j < settings.ModifierBindingCount; ++j)
+			{
+				unsigned button = j % RAW_INPUT_BUTTON_COUNT;
+				unsigned modifier = (button + 1 + j / RAW_INPUT_BUTTON_COUNT) % RAW_INPUT_BUTTON_COUNT;
+				if(modifier == button)
+					modifier = (modifier + 1) % RAW_INPUT_BUTTON_COUNT;
+
+				contextfile << button << " " << modifier << " - action " << ((j + i) % ACTION_BUILTIN_COUNT) << "\n";
+			}
+		}
+	}
+
+	void RemoveContextFiles(const BenchmarkSettings& settings)
+	{
+		for(unsigned i = 0; i < settings.ContextCount; ++i)
+		{
+			std::ostringstream filename;
+			filename << "BenchmarkContext" << i << ".txt";
+			std::remove(filename.str().c_str());
+		}
+
+		std::remove(ContextListFileName);
+	}
+
+
+	//
+	// Build the whole event stream, tracking which buttons are held so that
+	// presses and releases pair up as they would from real hardware
+	//
+	void GenerateEvents(const BenchmarkSettings& settings, std::vector<RawInputEvent>& events)
+	{
+		Random random(12345);
+		bool held[RAW_INPUT_BUTTON_COUNT] = { false };
+
+		events.resize(static_cast<size_t>(settings.EventsPerFrame) * (settings.FrameCount + WarmupFrames));
+		for(size_t i = 0; i < events.size(); ++i)
+		{
+			RawInputEvent& event = events[i];
+			event = RawInputEvent();
+
+			if(random.Next(100) < AxisEventPercent)
+			{
+				event.Type = RawInputEvent::EVENT_AXIS;
+				event.Axis = static_cast<RawInputAxis>(random.Next(RAW_INPUT_AXIS_COUNT));
+				event.Value = static_cast<double>(random.Next(2001)) - 1000.0;
+			}
+			else
+			{
+				unsigned button = random.Next(RAW_INPUT_BUTTON_COUNT);
+				event.Type = RawInputEvent::EVENT_BUTTON;
+				event.Button = static_cast<RawInputButton>(button);
+				event.PreviouslyPressed = held[button];
+				event.Pressed = !held[button];
+				held[button] = event.Pressed;
+			}
+		}
+	}
+
+
+	//
+	// Parse the command line; returns false if it is malformed
+	//
+	bool ParseSettings(int argc, char* argv[], BenchmarkSettings& settings)
+	{
+		settings.ContextCount = 4;
+		settings.StackDepth = 4;
+		settings.ModifierBindingCount = 16;
+		settings.CallbackCount = 16;
+		settings.EventsPerFrame = 64;
+		settings.FrameCount = 20000;
+
+		for(int i = 1; i + 1 < argc; i += 2)
+		{
+			unsigned value = static_cast<unsigned>(std::strtoul(argv[i + 1], NULL, 10));
+
+			if(std::strcmp(argv[i], "--contexts") == 0)
+				settings.ContextCount = value;
+			else if(std::strcmp(argv[i], "--depth") == 0)
+				settings.StackDepth = value;
+			else if(std::strcmp(argv[i], "--bindings") == 0)
+				settings.ModifierBindingCount = value;
+			else if(std::strcmp(argv[i], "--callbacks") == 0)
+				settings.CallbackCount = value;
+			else if(std::strcmp(argv[i], "--events") == 0)
+				settings.EventsPerFrame = value;
+			else if(std::strcmp(argv[i], "--frames") == 0)
+				settings.FrameCount = value;
+			else
+				return false;
+		}
+
+		if(argc % 2 == 0)
+			return false;
+
+		if(settings.ContextCount < 1 || settings.StackDepth > settings.ContextCount || settings.FrameCount < 1 || settings.EventsPerFrame < 1)
+			return false;
+
+		return true;
+	}
+
+}
+
+
+//
+// Callback target; counts invocations so the work cannot be optimized out
+//
+namespace
+{
+	unsigned long long CallbackInvocations = 0;
+
+	void CountingCallback(MappedInput&)
+	{
+		++CallbackInvocations;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	BenchmarkSettings settings;
+	if(!ParseSettings(argc, argv, settings))
+	{
+		std::fprintf(stderr, "Usage: %s [--contexts N] [--depth N] [--bindings N] [--callbacks N] [--events N] [--frames N]\n", argv[0]);
+		std::fprintf(stderr, "The stack depth may not exceed the number of contexts.\n");
+		return 1;
+	}
+
+	try
+	{
+		WriteContextFiles(settings);
+		std::shared_ptr<const ContextLibrary> library = ContextLibrary::LoadText(std::wstring(ContextListFileName, ContextListFileName + std::strlen(ContextListFileName)));
+		RemoveContextFiles(settings);
+
+		InputMapper mapper(*library);
+		for(unsigned i = 0; i < settings.StackDepth; ++i)
+		{
+			std::wostringstream name;
+			name << L"context" << i;
+			mapper.PushContext(name.str());
+		}
+
+		for(unsigned i = 0; i < settings.CallbackCount; ++i)
+		{
+			InputInterest interest;
+			interest.AddAction(static_cast<Action>(i % ACTION_BUILTIN_COUNT));
+			interest.AddState(static_cast<State>(i % STATE_BUILTIN_COUNT));
+			interest.AddRange(static_cast<Range>(i % RANGE_BUILTIN_COUNT));
+			mapper.AddCallback(&CountingCallback, static_cast<int>(i), interest);
+		}
+
+		std::vector<RawInputEvent> events;
+		GenerateEvents(settings, events);
+
+		CacheMissCounter cachemisses;
+
+		typedef std::chrono::steady_clock Clock;
+		Clock::duration mappingtime = Clock::duration::zero();
+		Clock::duration dispatchtime = Clock::duration::zero();
+		unsigned long long allocations = 0;
+		unsigned long long misses = 0;
+
+		for(unsigned frame = 0; frame < settings.FrameCount + WarmupFrames; ++frame)
+		{
+			bool measured = (frame >= WarmupFrames);
+			unsigned long long allocationsbefore = AllocationCount.load(std::memory_order_relaxed);
+			if(measured)
+				cachemisses.Start();
+
+			Clock::time_point start = Clock::now();
+
+			const RawInputEvent* frameevents = &events[static_cast<size_t>(frame) * settings.EventsPerFrame];
+			for(unsigned i = 0; i < settings.EventsPerFrame; ++i)
+			{
+				const RawInputEvent& event = frameevents[i];
+
+				bool queued;
+				if(event.Type == RawInputEvent::EVENT_BUTTON)
+					queued = mapper.QueueRawButtonState(event.Button, event.Pressed, event.PreviouslyPressed);
+				else
+					queued = mapper.QueueRawAxisValue(event.Axis, event.Value);
+
+				if(!queued)
+					throw std::runtime_error("Raw input queue overflowed; use fewer events per frame");
+			}
+
+			mapper.ProcessQueuedInput();
+			Clock::time_point mapped = Clock::now();
+
+			mapper.Dispatch();
+			mapper.Clear();
+			Clock::time_point dispatched = Clock::now();
+
+			if(measured)
+			{
+				misses += cachemisses.Stop();
+				mappingtime += mapped - start;
+				dispatchtime += dispatched - mapped;
+				allocations += AllocationCount.load(std::memory_order_relaxed) - allocationsbefore;
+			}
+		}
+
+		double eventcount = static_cast<double>(settings.EventsPerFrame) * settings.FrameCount;
+		double mappingns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(mappingtime).count());
+		double dispatchns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(dispatchtime).count());
+
+		std::printf("Contexts %u, stack depth %u, modifier bindings %u, callbacks %u\n", settings.ContextCount, settings.StackDepth, settings.ModifierBindingCount, settings.CallbackCount);
+		std::printf("Mapped %.0f events over %u frames (%llu callback invocations)\n\n", eventcount, settings.FrameCount, CallbackInvocations);
+		std::printf("  Mapping:       %10.1f ns/event\n", mappingns / eventcount);
+		std::printf("  Dispatch:      %10.1f ns/frame\n", dispatchns / settings.FrameCount);
+		std::printf("  Allocations:   %10.2f per frame\n", static_cast<double>(allocations) / settings.FrameCount);
+
+		if(cachemisses.IsAvailable())
+			std::printf("  Cache misses:  %10.2f per event\n", static_cast<double>(misses) / eventcount);
+		else
+			std::printf("  Cache misses:  %10s\n", "unavailable");
+	}
+	catch(const std::exception& e)
+	{
+		RemoveContextFiles(settings);
+		std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
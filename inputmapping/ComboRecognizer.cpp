@@ -0,0 +1,134 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Recognition of chords, timed button sequences, and combos
+//
+
+#include "pch.h"
+
+#include "ComboRecognizer.h"
+
+#include <stdexcept>
+
+
+using namespace InputMapping;
+
+
+//
+// Construct an empty recognizer, which never matches anything
+//
+ComboRecognizer::ComboRecognizer()
+	: ComboCount(0),
+	  StepCount(0),
+	  WordCount(0),
+	  Buttons(0)
+{
+}
+
+
+//
+// Compile a set of combo descriptions into the matching masks
+//
+// Each combo's steps occupy consecutive bits, in the same order as the
+// step array, so a combo's bit positions are just its step indices.
+//
+void ComboRecognizer::Build(const ComboDescription* combos, unsigned combocount, const unsigned* stepbuttons)
+{
+	if(combocount > MaxCombos)
+		throw std::runtime_error("Too many combos specified for a single context");
+
+	// Steps are validated first, so the tables can be sized to fit them
+	unsigned nextstep = 0;
+	for(unsigned i = 0; i < combocount; ++i)
+	{
+		const ComboDescription& combo = combos[i];
+		if(combo.Action >= ACTION_COUNT)
+			throw std::runtime_error("Out of range action ID in combo");
+
+		// Combos may not share steps, since each bit belongs to exactly one combo
+		if(combo.StepCount == 0 || combo.FirstStep < nextstep || combo.FirstStep >= MaxSteps || combo.StepCount > MaxSteps - combo.FirstStep)
+			throw std::runtime_error("Invalid step range in combo");
+
+		nextstep = combo.FirstStep + combo.StepCount;
+	}
+
+	StepCount = nextstep;
+	WordCount = (StepCount + 63) / 64;
+	Buttons = 0;
+
+	StartSteps.assign(WordCount, 0);
+	FinalSteps.assign(WordCount, 0);
+	ChordSteps.assign(WordCount, 0);
+	Advances.assign(RAW_INPUT_BUTTON_COUNT * WordCount, 0);
+	Holds.assign(RAW_INPUT_BUTTON_COUNT * WordCount, 0);
+	StepButtons.assign(StepCount, 0);
+	StepCombos.assign(StepCount, 0);
+	Combos.assign(combos, combos + combocount);
+	Windows.resize(combocount);
+
+	for(unsigned i = 0; i < combocount; ++i)
+	{
+		const ComboDescription& combo = combos[i];
+		for(unsigned j = 0; j < combo.StepCount; ++j)
+		{
+			unsigned position = combo.FirstStep + j;
+			unsigned buttons = stepbuttons[position];
+			if(buttons == 0 || (buttons >> (RAW_INPUT_BUTTON_COUNT - 1)) > 1)
+				throw std::runtime_error("Invalid buttons in combo step");
+
+			unsigned word = position / 64;
+			unsigned long long bit = 1ull << (position % 64);
+
+			StepButtons[position] = buttons;
+			StepCombos[position] = static_cast<unsigned short>(i);
+			Buttons |= buttons;
+
+			if(j == 0)
+				StartSteps[word] |= bit;
+
+			if(j == combo.StepCount - 1)
+				FinalSteps[word] |= bit;
+
+			if(buttons & (buttons - 1))
+				ChordSteps[word] |= bit;
+
+			for(unsigned button = 0; button < RAW_INPUT_BUTTON_COUNT; ++button)
+			{
+				if(!(buttons & (1u << button)))
+					continue;
+
+				Advances[(button * WordCount) + word] |= bit;
+
+				// Pressing part of a chord keeps the step before it alive
+				if(j > 0 && (buttons & (buttons - 1)))
+					Holds[(button * WordCount) + ((position - 1) / 64)] |= 1ull << ((position - 1) % 64);
+			}
+		}
+
+		Windows[i] = static_cast<InputTimestamp>(combo.WindowMilliseconds) * 1000;
+	}
+
+	ComboCount = combocount;
+}
+
+
+//
+// Helper: drop progress on any combo whose next step has taken too long
+//
+// Takes one word of active bits and returns the ones still in time. Only
+// active bits are visited, and there are rarely more than a handful.
+//
+unsigned long long ComboRecognizer::ExpireSteps(unsigned word, unsigned long long bits, const InputTimestamp* steptimes, InputTimestamp timestamp) const
+{
+	unsigned long long live = bits;
+	for(; bits; bits &= bits - 1)
+	{
+		unsigned position = (word * 64) + LowestBit(bits);
+		if(timestamp - steptimes[position] > Windows[StepCombos[position]])
+			live &= ~(1ull << (position % 64));
+	}
+
+	return live;
+}
@@ -0,0 +1,200 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Recognition of chords, timed button sequences, and combos
+//
+
+#pragma once
+
+
+// Dependencies
+#include "RawInputConstants.h"
+#include "InputConstants.h"
+#include "RawInputQueue.h"
+
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+// Capacity of a single context's combo tables; these may be raised
+// by defining them before including any input mapping headers
+//
+// Every context's tables reserve room for the full capacity (16 bytes per
+// combo and 4 per step, so 32 KB per context at the defaults), but the
+// recognizer and per-player progress are sized to the steps a context
+// actually uses. Loading a context which needs more fails with an error.
+#ifndef INPUTMAPPING_MAX_COMBOS
+#define INPUTMAPPING_MAX_COMBOS 1024
+#endif
+
+#ifndef INPUTMAPPING_MAX_COMBO_STEPS
+#define INPUTMAPPING_MAX_COMBO_STEPS 4096
+#endif
+
+
+namespace InputMapping
+{
+
+	static_assert(RAW_INPUT_BUTTON_COUNT <= 32, "Combo steps store their buttons as a 32-bit mask");
+	static_assert(INPUTMAPPING_MAX_COMBOS <= 0x10000, "Combo indices are stored in 16 bits");
+
+
+	//
+	// Serializable description of one combo
+	//
+	// A combo is a sequence of steps, each of which is one button or a chord
+	// of several buttons held together. The steps themselves are stored in a
+	// separate array as button masks, starting at FirstStep. Each step must
+	// follow the previous one within the combo's window.
+	//
+	struct ComboDescription
+	{
+		unsigned Action;
+		unsigned WindowMilliseconds;
+		unsigned FirstStep;
+		unsigned StepCount;
+	};
+
+
+	//
+	// Automaton matching every combo of one context at once
+	//
+	// All combos are laid end to end in a single bit vector, one bit per
+	// step, and matched with the multi-pattern Shift-And technique: each
+	// button press shifts the active bits along by one, injects the first
+	// step of every combo, and masks the result against the precomputed set
+	// of steps that press can satisfy. The cost of a press is therefore a
+	// few word-wide operations per 64 steps defined, so even a context with
+	// the full capacity of combos costs a press only a few hundred of them.
+	//
+	// A press which does not advance a combo breaks it, except that pressing
+	// one button of a chord which is the next step leaves progress where it
+	// is, so the chord's buttons can go down in any order.
+	//
+	class ComboRecognizer
+	{
+	// Constants
+	public:
+		static const unsigned MaxCombos = INPUTMAPPING_MAX_COMBOS;
+		static const unsigned MaxSteps = INPUTMAPPING_MAX_COMBO_STEPS;
+
+	// Construction
+	public:
+		ComboRecognizer();
+
+	// Configuration interface
+	public:
+		void Build(const ComboDescription* combos, unsigned combocount, const unsigned* stepbuttons);
+
+		bool IsEmpty() const
+		{ return ComboCount == 0; }
+
+		// Raw buttons used by any step of any combo, one bit per button
+		unsigned GetButtons() const
+		{ return Buttons; }
+
+		// Number of words of progress, and of step timestamps, callers must keep per player
+		unsigned GetWordCount() const
+		{ return WordCount; }
+
+		unsigned GetStepCount() const
+		{ return StepCount; }
+
+	// Recognition interface
+	public:
+		//
+		// Feed a button press into the automaton
+		//
+		// Progress is kept by the caller, as GetWordCount() words of active
+		// bits (all zero to start with) and GetStepCount() timestamps. Bit N
+		// is set when the first N+1 steps, counting from the start of the
+		// combo which owns position N, have just been matched, and timestamp
+		// N is when that happened. The held mask has one bit per raw button
+		// currently down, including the one just pressed. The emit functor
+		// is called with the Action of each combo completed by this press.
+		//
+		template <typename EmitT>
+		void Press(unsigned long long* active, InputTimestamp* steptimes, RawInputButton button, unsigned heldbuttons, InputTimestamp timestamp, EmitT emit) const
+		{
+			const unsigned long long* advances = Advances.data() + (button * WordCount);
+			const unsigned long long* holds = Holds.data() + (button * WordCount);
+
+			unsigned long long carry = 0;
+			for(unsigned i = 0; i < WordCount; ++i)
+			{
+				unsigned long long current = active[i] ? ExpireSteps(i, active[i], steptimes, timestamp) : 0;
+				unsigned long long advanced = ((current << 1) | carry | StartSteps[i]) & advances[i];
+				carry = current >> 63;
+
+				// Chord steps only advance once every button of the chord is down
+				for(unsigned long long chords = advanced & ChordSteps[i]; chords; chords &= chords - 1)
+				{
+					unsigned position = (i * 64) + LowestBit(chords);
+					if((heldbuttons & StepButtons[position]) != StepButtons[position])
+						advanced &= ~(1ull << (position & 63));
+				}
+
+				for(unsigned long long bits = advanced; bits; bits &= bits - 1)
+					steptimes[(i * 64) + LowestBit(bits)] = timestamp;
+
+				for(unsigned long long finished = advanced & FinalSteps[i]; finished; finished &= finished - 1)
+					emit(static_cast<Action>(Combos[StepCombos[(i * 64) + LowestBit(finished)]].Action));
+
+				active[i] = (advanced & ~FinalSteps[i]) | (current & holds[i]);
+			}
+		}
+
+	// Internal helpers
+	private:
+		unsigned long long ExpireSteps(unsigned word, unsigned long long bits, const InputTimestamp* steptimes, InputTimestamp timestamp) const;
+
+		static unsigned LowestBit(unsigned long long bits)
+		{
+#if defined(_MSC_VER) && defined(_M_IX86)
+			// 32-bit builds only have the 32-bit scan, so take each half in turn
+			unsigned long index;
+			if(_BitScanForward(&index, static_cast<unsigned long>(bits)))
+				return index;
+
+			_BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+			return index + 32;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, bits);
+			return index;
+#else
+			return static_cast<unsigned>(__builtin_ctzll(bits));
+#endif
+		}
+
+	// Internal tracking
+	private:
+		// One bit per step, in words of 64; the tables are sized to the
+		// steps actually used, so a press only touches that many words
+		std::vector<unsigned long long> StartSteps;
+		std::vector<unsigned long long> FinalSteps;
+		std::vector<unsigned long long> ChordSteps;
+
+		// Steps a press of each button can complete, and steps a press of each
+		// button leaves in place because it is part of the chord that follows;
+		// WordCount words per button
+		std::vector<unsigned long long> Advances;
+		std::vector<unsigned long long> Holds;
+
+		std::vector<unsigned> StepButtons;
+		std::vector<unsigned short> StepCombos;
+
+		std::vector<ComboDescription> Combos;
+		std::vector<InputTimestamp> Windows;
+		unsigned ComboCount;
+		unsigned StepCount;
+		unsigned WordCount;
+		unsigned Buttons;
+	};
+
+}
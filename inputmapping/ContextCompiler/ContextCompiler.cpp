@@ -0,0 +1,286 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Offline tool for compiling text input contexts into a binary context image
+//
+// Usage: ContextCompiler <context list file> <output image file>
+//        ContextCompiler -header <context list file> <output header file>
+//
+// The context list has the same format as ContextList.txt; the context files
+// it names are opened relative to the current working directory, exactly as
+// the demo itself would open them.
+//
+// The second form writes a C++ header instead, defining every context as a
+// StaticInputContext whose tables are constant expressions; this is meant
+// for shipping builds with fixed bindings.
+//
+
+#include "pch.h"
+
+#include "ContextSet.h"
+#include "InputContext.h"
+#include "ContextImage.h"
+#include "FileIO.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+
+using namespace InputMapping;
+
+
+//
+// Internal helpers
+//
+namespace
+{
+	//
+	// Helper for turning a context or identifier name into a valid C++ identifier
+	//
+	std::string MakeCppIdentifier(const std::wstring& name)
+	{
+		std::string ret;
+		for(std::wstring::const_iterator iter = name.begin(); iter != name.end(); ++iter)
+		{
+			wchar_t c = *iter;
+			if((c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9'))
+				ret.push_back(static_cast<char>(c));
+			else
+				ret.push_back('_');
+		}
+
+		if(ret.empty() || (ret[0] >= '0' && ret[0] <= '9'))
+			ret.insert(ret.begin(), '_');
+
+		return ret;
+	}
+
+	//
+	// Helper for writing a double so that it reads back exactly
+	//
+	std::string FormatDouble(double value)
+	{
+		if(std::isinf(value))
+			return value < 0.0 ? "-std::numeric_limits<double>::infinity()" : "std::numeric_limits<double>::infinity()";
+
+		std::ostringstream stream;
+		stream.precision(17);
+		stream << value;
+
+		std::string ret = stream.str();
+		if(ret.find_first_of(".e") == std::string::npos)
+			ret += ".0";
+
+		return ret;
+	}
+
+	//
+	// Helper for writing constants for every identifier of one kind declared in data
+	//
+	void WriteIdentifierConstants(std::ostream& out, const InputIdentifierTable& identifiers, InputIdentifierKind kind, unsigned builtincount, const char* scopename, const char* typenm)
+	{
+		if(identifiers.GetCount(kind) <= builtincount)
+			return;
+
+		out << "\tnamespace " << scopename << "\n\t{\n";
+		for(unsigned id = builtincount; id < identifiers.GetCount(kind); ++id)
+			out << "\t\tconstexpr " << typenm << " " << MakeCppIdentifier(identifiers.GetName(kind, id)) << " = static_cast<" << typenm << ">(" << id << ");\n";
+		out << "\t}\n\n";
+	}
+
+	//
+	// Helper for writing one context's tables as a constexpr aggregate initializer
+	//
+	void WriteTables(std::ostream& out, const ContextTables& tables)
+	{
+		out << "\t\tstatic constexpr ContextTables Tables =\n\t\t{\n";
+
+		out << "\t\t\t// Buttons (action, state)\n\t\t\t{";
+		for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+			out << (i ? ", " : " ") << "{ " << tables.Buttons[i].MappedAction << ", " << tables.Buttons[i].MappedState << " }";
+		out << " },\n";
+
+		out << "\t\t\t// Axes\n\t\t\t{";
+		for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+			out << (i ? ", " : " ") << tables.Axes[i];
+		out << " },\n";
+
+		out << "\t\t\t// Sensitivities\n\t\t\t{";
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+			out << (i ? ", " : " ") << FormatDouble(tables.Sensitivities[i]);
+		out << " },\n";
+
+		out << "\t\t\t// Conversions (minimum input, maximum input, scale, offset)\n\t\t\t{\n";
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+		{
+			const RangeConversion& conversion = tables.Conversions[i];
+			out << "\t\t\t\t{ " << FormatDouble(conversion.MinimumInput) << ", " << FormatDouble(conversion.MaximumInput) << ", "
+				<< FormatDouble(conversion.Scale) << ", " << FormatDouble(conversion.Offset) << " },\n";
+		}
+		out << "\t\t\t},\n";
+
+		out << "\t\t\t// Filter stage counts\n\t\t\t{";
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+			out << (i ? ", " : " ") << tables.FilterStageCounts[i];
+		out << " },\n";
+
+		out << "\t\t\t// Filter stages (type, parameter)\n\t\t\t{\n";
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+		{
+			out << "\t\t\t\t{";
+			for(unsigned j = 0; j < tables.FilterStageCounts[i]; ++j)
+				out << (j ? ", " : " ") << "{ " << tables.FilterStages[i][j].Type << ", " << FormatDouble(tables.FilterStages[i][j].Parameter) << " }";
+			out << (tables.FilterStageCounts[i] ? " },\n" : "},\n");
+		}
+		out << "\t\t\t},\n";
+
+		out << "\t\t\t// Combo count\n\t\t\t" << tables.ComboCount << ",\n";
+
+		out << "\t\t\t// Combos (action, window, first step, step count)\n\t\t\t{";
+		for(unsigned i = 0; i < tables.ComboCount; ++i)
+		{
+			const ComboDescription& combo = tables.Combos[i];
+			out << (i ? ", " : " ") << "{ " << combo.Action << ", " << combo.WindowMilliseconds << ", " << combo.FirstStep << ", " << combo.StepCount << " }";
+		}
+		out << (tables.ComboCount ? " },\n" : "},\n");
+
+		unsigned stepcount = tables.ComboCount ? tables.Combos[tables.ComboCount - 1].FirstStep + tables.Combos[tables.ComboCount - 1].StepCount : 0;
+
+		out << "\t\t\t// Combo step buttons\n\t\t\t{";
+		for(unsigned i = 0; i < stepcount; ++i)
+			out << (i ? ", " : " ") << tables.ComboStepButtons[i];
+		out << (stepcount ? " },\n" : "},\n");
+
+		out << "\t\t\t// Modifier binding count\n\t\t\t" << tables.ModifierBindingCount << ",\n";
+
+		out << "\t\t\t// Modifier bindings (button, required buttons, excluded buttons, action, state)\n\t\t\t{";
+		for(unsigned i = 0; i < tables.ModifierBindingCount; ++i)
+		{
+			const ModifierBindingDescription& binding = tables.ModifierBindings[i];
+			out << (i ? ",\n\t\t\t\t" : "\n\t\t\t\t") << "{ " << binding.Button << ", " << binding.RequiredButtons << ", " << binding.ExcludedButtons
+				<< ", " << binding.MappedAction << ", " << binding.MappedState << " }";
+		}
+		out << (tables.ModifierBindingCount ? "\n\t\t\t},\n" : "},\n");
+
+		out << "\t\t};\n";
+	}
+
+	//
+	// Write a header defining every context as a StaticInputContext
+	//
+	// The header asserts the layout it was generated against, so that it
+	// fails to compile rather than misbehaving if the constants change.
+	//
+	void WriteStaticContextHeader(const std::wstring& filename, const std::wstring& listfilename, const ContextSet& contexts)
+	{
+		std::ostringstream out;
+
+		out << "//\n// Static input contexts generated by ContextCompiler from " << NarrowFileName(listfilename) << "\n//\n// Do not edit; regenerate this file from the text context files instead.\n//\n\n";
+		out << "#pragma once\n\n\n// Dependencies\n#include \"StaticInputContext.h\"\n\n#include <limits>\n\n\n";
+		out << "static_assert(InputMapping::RAW_INPUT_BUTTON_COUNT == " << RAW_INPUT_BUTTON_COUNT
+			<< " && InputMapping::RAW_INPUT_AXIS_COUNT == " << RAW_INPUT_AXIS_COUNT
+			<< " && InputMapping::ACTION_COUNT == " << ACTION_COUNT
+			<< " && InputMapping::STATE_COUNT == " << STATE_COUNT
+			<< " && InputMapping::RANGE_COUNT == " << RANGE_COUNT
+			<< " && InputMapping::AnalogFilterState::MaxStages == " << AnalogFilterState::MaxStages
+			<< " && InputMapping::ComboRecognizer::MaxCombos == " << ComboRecognizer::MaxCombos
+			<< " && InputMapping::ComboRecognizer::MaxSteps == " << ComboRecognizer::MaxSteps
+			<< " && InputMapping::ModifierBindingTable::MaxBindings == " << ModifierBindingTable::MaxBindings
+			<< ", \"Static input contexts are out of date; regenerate them with ContextCompiler\");\n\n\n";
+
+		out << "namespace InputMapping\n{\nnamespace StaticContexts\n{\n\n";
+
+		WriteIdentifierConstants(out, contexts.Identifiers, INPUT_IDENTIFIER_ACTION, ACTION_BUILTIN_COUNT, "Actions", "Action");
+		WriteIdentifierConstants(out, contexts.Identifiers, INPUT_IDENTIFIER_STATE, STATE_BUILTIN_COUNT, "States", "State");
+		WriteIdentifierConstants(out, contexts.Identifiers, INPUT_IDENTIFIER_RANGE, RANGE_BUILTIN_COUNT, "Ranges", "Range");
+
+		for(ContextSet::EntryMapT::const_iterator iter = contexts.Entries.begin(); iter != contexts.Entries.end(); ++iter)
+		{
+			std::string name = MakeCppIdentifier(iter->first);
+
+			out << "\tstruct " << name << "Definition\n\t{\n";
+			WriteTables(out, iter->second.Context->GetTables());
+			out << "\t};\n\n";
+			out << "\ttypedef StaticInputContext<" << name << "Definition> " << name << ";\n\n";
+		}
+
+		out << "}\n}\n\n";
+
+		// Written beside the target and renamed over it, so a build picking
+		// up the header never sees it half written
+		{
+			std::ofstream outfile(NarrowFileName(GetReplacementFileName(filename)).c_str(), std::ios::trunc);
+			if(!outfile)
+				throw std::runtime_error("Failed to open static context header for writing");
+
+			outfile << out.str();
+			outfile.close();
+			if(!outfile)
+			{
+				DiscardReplacementFile(filename);
+				throw std::runtime_error("Failed to write static context header");
+			}
+		}
+
+		CommitReplacementFile(filename);
+	}
+}
+
+
+//
+// Entry point for the compiler
+//
+int main(int argc, char* argv[])
+{
+	bool header = (argc == 4 && std::strcmp(argv[1], "-header") == 0);
+	if(argc != 3 && !header)
+	{
+		std::cerr << "Usage: ContextCompiler <context list file> <output image file>" << std::endl;
+		std::cerr << "       ContextCompiler -header <context list file> <output header file>" << std::endl;
+		return 1;
+	}
+
+	const char* listarg = argv[argc - 2];
+	const char* outputarg = argv[argc - 1];
+
+	std::wstring listfile(listarg, listarg + std::strlen(listarg));
+	std::wstring outputfile(outputarg, outputarg + std::strlen(outputarg));
+
+	try
+	{
+		// Load exactly as the demo would, so identifiers and contexts match
+		std::shared_ptr<const ContextSet> contexts = ContextSet::LoadText(listfile, NULL);
+
+		if(header)
+		{
+			WriteStaticContextHeader(outputfile, listfile, *contexts);
+			std::cout << "Generated " << contexts->Entries.size() << " static context(s) into " << outputarg << std::endl;
+			return 0;
+		}
+
+		std::vector<std::wstring> names;
+		std::vector<const ContextTables*> tables;
+		for(ContextSet::EntryMapT::const_iterator iter = contexts->Entries.begin(); iter != contexts->Entries.end(); ++iter)
+		{
+			names.push_back(iter->first);
+			tables.push_back(&iter->second.Context->GetTables());
+		}
+
+		WriteCompiledContextImage(outputfile, names, tables, contexts->Identifiers);
+		std::cout << "Compiled " << names.size() << " context(s) into " << outputarg << std::endl;
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,265 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Binary images of precompiled input contexts
+//
+
+#include "pch.h"
+
+#include "ContextImage.h"
+#include "FileIO.h"
+
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+
+using namespace InputMapping;
+
+
+//
+// Internal helpers
+//
+namespace
+{
+	const char CompiledContextMagic[4] = { 'I', 'M', 'C', 'X' };
+	const unsigned CompiledContextVersion = 2;
+
+	//
+	// Helper for appending a name to the name pool of an image being written
+	//
+	void AppendName(std::string& namepool, const std::wstring& name)
+	{
+		for(std::wstring::const_iterator iter = name.begin(); iter != name.end(); ++iter)
+		{
+			if(*iter > 0x7f)
+				throw std::runtime_error("Context and identifier names must be plain ASCII to be compiled");
+
+			namepool.push_back(static_cast<char>(*iter));
+		}
+	}
+
+	//
+	// Helper for checking that a name stored in an image lies within it
+	//
+	bool IsNameInBounds(unsigned offset, unsigned length, size_t size)
+	{
+		return offset <= size && length <= size - offset;
+	}
+
+	//
+	// Helper for rounding an offset up so the tables stored there are suitably aligned
+	//
+	unsigned AlignOffset(unsigned offset)
+	{
+		return (offset + 7) & ~7u;
+	}
+}
+
+
+//
+// Write a compiled context image holding the given contexts
+//
+void InputMapping::WriteCompiledContextImage(const std::wstring& filename, const std::vector<std::wstring>& names, const std::vector<const ContextTables*>& tables, const InputIdentifierTable& identifiers)
+{
+	if(names.size() != tables.size())
+		throw std::runtime_error("Mismatched context names and tables");
+
+	CompiledContextHeader header;
+	std::memcpy(header.Magic, CompiledContextMagic, sizeof(header.Magic));
+	header.Version = CompiledContextVersion;
+	header.TablesSize = sizeof(ContextTables);
+	header.RawButtonCount = RAW_INPUT_BUTTON_COUNT;
+	header.RawAxisCount = RAW_INPUT_AXIS_COUNT;
+	header.ActionCount = ACTION_COUNT;
+	header.StateCount = STATE_COUNT;
+	header.RangeCount = RANGE_COUNT;
+	header.ContextCount = static_cast<unsigned>(names.size());
+
+	unsigned identifiercount = 0;
+	for(unsigned kind = 0; kind < INPUT_IDENTIFIER_KIND_COUNT; ++kind)
+	{
+		header.IdentifierCounts[kind] = identifiers.GetCount(static_cast<InputIdentifierKind>(kind));
+		identifiercount += header.IdentifierCounts[kind];
+	}
+
+	// Lay out the directories, name pool, and tables
+	std::vector<CompiledContextEntry> directory(names.size());
+	std::vector<CompiledIdentifierEntry> identifierdirectory;
+	std::string namepool;
+
+	unsigned offset = sizeof(CompiledContextHeader) + static_cast<unsigned>(sizeof(CompiledContextEntry) * directory.size()) + static_cast<unsigned>(sizeof(CompiledIdentifierEntry) * identifiercount);
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		directory[i].NameOffset = offset + static_cast<unsigned>(namepool.size());
+		directory[i].NameLength = static_cast<unsigned>(names[i].size());
+		AppendName(namepool, names[i]);
+	}
+
+	for(unsigned kind = 0; kind < INPUT_IDENTIFIER_KIND_COUNT; ++kind)
+	{
+		for(unsigned id = 0; id < header.IdentifierCounts[kind]; ++id)
+		{
+			const std::wstring& name = identifiers.GetName(static_cast<InputIdentifierKind>(kind), id);
+
+			CompiledIdentifierEntry entry;
+			entry.NameOffset = offset + static_cast<unsigned>(namepool.size());
+			entry.NameLength = static_cast<unsigned>(name.size());
+			identifierdirectory.push_back(entry);
+			AppendName(namepool, name);
+		}
+	}
+
+	offset = AlignOffset(offset + static_cast<unsigned>(namepool.size()));
+	for(size_t i = 0; i < tables.size(); ++i)
+	{
+		directory[i].TablesOffset = offset;
+		offset = AlignOffset(offset + sizeof(ContextTables));
+	}
+
+	// Emit everything in order, padding up to each table. Running mappers
+	// read their tables straight out of a mapping of the existing image, so
+	// it must never be rewritten in place; the new image is written beside
+	// it and renamed over it once complete.
+	{
+		std::ofstream outfile(NarrowFileName(GetReplacementFileName(filename)).c_str(), std::ios::binary | std::ios::trunc);
+		if(!outfile)
+			throw std::runtime_error("Failed to open compiled context image for writing");
+
+		outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		if(!directory.empty())
+			outfile.write(reinterpret_cast<const char*>(&directory[0]), sizeof(CompiledContextEntry) * directory.size());
+		if(!identifierdirectory.empty())
+			outfile.write(reinterpret_cast<const char*>(&identifierdirectory[0]), sizeof(CompiledIdentifierEntry) * identifierdirectory.size());
+		outfile.write(namepool.data(), namepool.size());
+
+		for(size_t i = 0; i < tables.size(); ++i)
+		{
+			while(static_cast<unsigned>(outfile.tellp()) < directory[i].TablesOffset)
+				outfile.put('\0');
+
+			outfile.write(reinterpret_cast<const char*>(tables[i]), sizeof(ContextTables));
+		}
+
+		outfile.close();
+		if(!outfile)
+		{
+			DiscardReplacementFile(filename);
+			throw std::runtime_error("Failed to write compiled context image");
+		}
+	}
+
+	CommitReplacementFile(filename);
+}
+
+
+//
+// Map a compiled context image and validate its layout
+//
+CompiledContextImage::CompiledContextImage(const std::wstring& filename)
+	: File(filename),
+	  Header(NULL),
+	  Directory(NULL),
+	  IdentifierDirectory(NULL)
+{
+	const char* base = static_cast<const char*>(File.GetData());
+	size_t size = File.GetSize();
+
+	if(size < sizeof(CompiledContextHeader))
+		throw std::runtime_error("Compiled context image is truncated");
+
+	Header = reinterpret_cast<const CompiledContextHeader*>(base);
+	if(std::memcmp(Header->Magic, CompiledContextMagic, sizeof(Header->Magic)) != 0)
+		throw std::runtime_error("File is not a compiled context image");
+
+	if(Header->Version != CompiledContextVersion || Header->TablesSize != sizeof(ContextTables)
+	|| Header->RawButtonCount != RAW_INPUT_BUTTON_COUNT || Header->RawAxisCount != RAW_INPUT_AXIS_COUNT
+	|| Header->ActionCount != ACTION_COUNT || Header->StateCount != STATE_COUNT || Header->RangeCount != RANGE_COUNT)
+		throw std::runtime_error("Compiled context image is out of date; recompile it from the text context files");
+
+	if((size - sizeof(CompiledContextHeader)) / sizeof(CompiledContextEntry) < Header->ContextCount)
+		throw std::runtime_error("Compiled context image is truncated");
+
+	size_t identifierdirectoryoffset = sizeof(CompiledContextHeader) + (sizeof(CompiledContextEntry) * Header->ContextCount);
+	size_t identifiercount = 0;
+	for(unsigned kind = 0; kind < INPUT_IDENTIFIER_KIND_COUNT; ++kind)
+		identifiercount += Header->IdentifierCounts[kind];
+
+	if((size - identifierdirectoryoffset) / sizeof(CompiledIdentifierEntry) < identifiercount)
+		throw std::runtime_error("Compiled context image is truncated");
+
+	Directory = reinterpret_cast<const CompiledContextEntry*>(base + sizeof(CompiledContextHeader));
+	IdentifierDirectory = reinterpret_cast<const CompiledIdentifierEntry*>(base + identifierdirectoryoffset);
+
+	for(size_t i = 0; i < identifiercount; ++i)
+	{
+		if(!IsNameInBounds(IdentifierDirectory[i].NameOffset, IdentifierDirectory[i].NameLength, size))
+			throw std::runtime_error("Compiled context image is truncated");
+	}
+
+	for(unsigned i = 0; i < Header->ContextCount; ++i)
+	{
+		const CompiledContextEntry& entry = Directory[i];
+		if(!IsNameInBounds(entry.NameOffset, entry.NameLength, size))
+			throw std::runtime_error("Compiled context image is truncated");
+
+		if((entry.TablesOffset & 7) != 0 || entry.TablesOffset > size || sizeof(ContextTables) > size - entry.TablesOffset)
+			throw std::runtime_error("Compiled context image is truncated");
+	}
+}
+
+
+//
+// Retrieve the name of a context in the image
+//
+std::wstring CompiledContextImage::GetContextName(unsigned index) const
+{
+	const CompiledContextEntry& entry = Directory[index];
+	const char* name = static_cast<const char*>(File.GetData()) + entry.NameOffset;
+	return std::wstring(name, name + entry.NameLength);
+}
+
+//
+// Retrieve the tables of a context in the image, for use in place
+//
+const ContextTables& CompiledContextImage::GetContextTables(unsigned index) const
+{
+	const char* tables = static_cast<const char*>(File.GetData()) + Directory[index].TablesOffset;
+	return *reinterpret_cast<const ContextTables*>(tables);
+}
+
+//
+// Fill in an identifier table with the named identifiers stored in the image
+//
+// The built-in identifiers are already present in any table, so they are
+// only checked against the image, in case the built-ins have changed since
+// it was compiled; the rest are declared in ID order.
+//
+void CompiledContextImage::LoadIdentifiers(InputIdentifierTable& identifiers) const
+{
+	const char* base = static_cast<const char*>(File.GetData());
+	const CompiledIdentifierEntry* entry = IdentifierDirectory;
+
+	for(unsigned kind = 0; kind < INPUT_IDENTIFIER_KIND_COUNT; ++kind)
+	{
+		InputIdentifierKind identifierkind = static_cast<InputIdentifierKind>(kind);
+		unsigned builtincount = identifiers.GetCount(identifierkind);
+
+		for(unsigned id = 0; id < Header->IdentifierCounts[kind]; ++id, ++entry)
+		{
+			std::wstring name(base + entry->NameOffset, base + entry->NameOffset + entry->NameLength);
+			if(id >= builtincount)
+				identifiers.Declare(identifierkind, name);
+			else if(identifiers.GetName(identifierkind, id) != name)
+				throw std::runtime_error("Compiled context image is out of date; recompile it from the text context files");
+		}
+
+		if(Header->IdentifierCounts[kind] < builtincount)
+			throw std::runtime_error("Compiled context image is out of date; recompile it from the text context files");
+	}
+
+	identifiers.Build();
+}
+
@@ -0,0 +1,103 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Binary images of precompiled input contexts
+//
+
+#pragma once
+
+
+// Dependencies
+#include "ContextTables.h"
+#include "InputIdentifiers.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	//
+	// Layout of a compiled context image
+	//
+	// An image begins with this header, followed by a directory holding one
+	// entry per context, and then one entry per named identifier (ordered by
+	// kind, then by ID). After that comes a pool of context and identifier
+	// names (plain ASCII, not terminated), and then each context's tables,
+	// aligned to 8 bytes. All offsets are in bytes from the start of the
+	// image.
+	//
+	// The header records the size of the tables and the number of each kind
+	// of ID, so an image built against a different layout is rejected rather
+	// than misread. Bump the version for any other change to the format.
+	//
+	struct CompiledContextHeader
+	{
+		char Magic[4];
+		unsigned Version;
+
+		unsigned TablesSize;
+		unsigned RawButtonCount;
+		unsigned RawAxisCount;
+		unsigned ActionCount;
+		unsigned StateCount;
+		unsigned RangeCount;
+
+		unsigned ContextCount;
+		unsigned IdentifierCounts[INPUT_IDENTIFIER_KIND_COUNT];
+	};
+
+	struct CompiledContextEntry
+	{
+		unsigned NameOffset;
+		unsigned NameLength;
+		unsigned TablesOffset;
+	};
+
+	struct CompiledIdentifierEntry
+	{
+		unsigned NameOffset;
+		unsigned NameLength;
+	};
+
+
+	//
+	// Write a compiled context image holding the given contexts
+	//
+	void WriteCompiledContextImage(const std::wstring& filename, const std::vector<std::wstring>& names, const std::vector<const ContextTables*>& tables, const InputIdentifierTable& identifiers);
+
+
+	//
+	// Compiled context image, mapped into memory and used in place
+	//
+	class CompiledContextImage
+	{
+	// Construction
+	public:
+		explicit CompiledContextImage(const std::wstring& filename);
+
+	// Access interface
+	public:
+		unsigned GetContextCount() const
+		{ return Header->ContextCount; }
+
+		std::wstring GetContextName(unsigned index) const;
+		const ContextTables& GetContextTables(unsigned index) const;
+
+		void LoadIdentifiers(InputIdentifierTable& identifiers) const;
+
+	// Internal tracking
+	private:
+		MappedFile File;
+
+		const CompiledContextHeader* Header;
+		const CompiledContextEntry* Directory;
+		const CompiledIdentifierEntry* IdentifierDirectory;
+	};
+
+}
+
@@ -0,0 +1,165 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Shared input contexts, and mapping for many players at once
+//
+
+#include "pch.h"
+
+#include "ContextLibrary.h"
+#include "ContextSet.h"
+#include "InputContext.h"
+
+#include <stdexcept>
+
+
+using namespace InputMapping;
+
+
+//
+// Construct a library over an already loaded set of contexts
+//
+ContextLibrary::ContextLibrary(const std::shared_ptr<const ContextSet>& contexts)
+	: Contexts(contexts)
+{
+	for(ContextSet::EntryMapT::const_iterator iter = Contexts->Entries.begin(); iter != Contexts->Entries.end(); ++iter)
+	{
+		ContextHandles.insert(std::make_pair(iter->first, static_cast<ContextHandle>(ContextsByHandle.size())));
+		ContextsByHandle.push_back(iter->second.Context.get());
+	}
+}
+
+//
+// Load a library from the text context files named in a context list
+//
+std::shared_ptr<const ContextLibrary> ContextLibrary::LoadText(const std::wstring& listfilename)
+{
+	return std::make_shared<const ContextLibrary>(ContextSet::LoadText(listfilename, NULL));
+}
+
+//
+// Load a library from a compiled context image
+//
+std::shared_ptr<const ContextLibrary> ContextLibrary::LoadCompiled(const std::wstring& imagefilename)
+{
+	return std::make_shared<const ContextLibrary>(ContextSet::LoadCompiled(imagefilename, NULL));
+}
+
+
+//
+// Look up the handle used to push a context by name
+//
+ContextHandle ContextLibrary::GetContextHandle(const std::wstring& name) const
+{
+	std::map<std::wstring, ContextHandle>::const_iterator iter = ContextHandles.find(name);
+	if(iter == ContextHandles.end())
+		return InvalidContextHandle;
+
+	return iter->second;
+}
+
+//
+// Retrieve the named identifiers declared alongside the contexts
+//
+const InputIdentifierTable& ContextLibrary::GetIdentifiers() const
+{
+	return Contexts->Identifiers;
+}
+
+
+//
+// Push a context onto a player's stack
+//
+// The context claims the inputs it binds in a copy of the resolved table
+// beneath it, exactly as an InputMapper does. Combos and analog filters
+// need per-player history which a player does not have room for, so
+// contexts using either are refused; map such players with an InputMapper.
+//
+void ContextLibrary::PushContext(PlayerInputState& player, ContextHandle handle) const
+{
+	if(handle >= ContextsByHandle.size())
+		throw std::runtime_error("Invalid input context pushed");
+
+	if(player.ContextDepth >= PlayerInputState::MaxContextDepth)
+		throw std::runtime_error("Too many input contexts pushed for a single player");
+
+	const InputContext* context = ContextsByHandle[handle];
+	if(!context->GetCombos().IsEmpty() || context->HasFilterChains())
+		throw std::runtime_error("Input contexts with combos or analog filters must be mapped with an InputMapper");
+
+	ResolvedBindings& resolved = player.Resolved[player.ContextDepth];
+	if(player.ContextDepth)
+		resolved = player.Resolved[player.ContextDepth - 1];
+	else
+		resolved.Reset();
+
+	context->OverlayBindings(resolved, static_cast<unsigned short>(player.ContextDepth));
+	player.ActiveContexts[player.ContextDepth++] = handle;
+}
+
+//
+// Pop the top context off a player's stack
+//
+void ContextLibrary::PopContext(PlayerInputState& player) const
+{
+	if(!player.ContextDepth)
+		throw std::runtime_error("Cannot pop input context, no contexts active!");
+
+	--player.ContextDepth;
+}
+
+
+//
+// Map a single raw event for a player
+//
+void ContextLibrary::MapRawEvent(PlayerInputState& player, const RawInputEvent& event) const
+{
+	if(event.Type == RawInputEvent::EVENT_BUTTON)
+		MapRawButtonState(player, event.Button, event.Pressed, event.PreviouslyPressed);
+	else
+		MapRawAxisValue(player, event.Axis, event.Value);
+}
+
+//
+// Map a raw button state change for a player
+//
+// This follows the same rules as the input mapper, through the same code:
+// the topmost context binding the button in any way maps it, hiding the
+// contexts beneath, and the player's resolved table finds that context.
+//
+void ContextLibrary::MapRawButtonState(PlayerInputState& player, RawInputButton button, bool pressed, bool previouslypressed) const
+{
+	if(pressed)
+		player.HeldButtons |= (1u << button);
+	else
+		player.HeldButtons &= ~(1u << button);
+
+	if(!player.ContextDepth)
+		return;
+
+	unsigned short owner = player.Resolved[player.ContextDepth - 1].ButtonOwners[button];
+	if(owner != NoBindingOwner)
+		ContextsByHandle[player.ActiveContexts[owner]]->MapButton(player.Mapped, button, pressed, previouslypressed, player.HeldButtons);
+}
+
+//
+// Map a raw axis value for a player
+//
+// The topmost context binding the axis converts it; the latest value
+// mapped to a range within a tick wins.
+//
+void ContextLibrary::MapRawAxisValue(PlayerInputState& player, RawInputAxis axis, double value) const
+{
+	if(!player.ContextDepth)
+		return;
+
+	unsigned short owner = player.Resolved[player.ContextDepth - 1].AxisOwners[axis];
+	if(owner == NoBindingOwner)
+		return;
+
+	const InputContext* context = ContextsByHandle[player.ActiveContexts[owner]];
+	Range range = static_cast<Range>(context->GetTables().Axes[axis]);
+	player.Mapped.SetRange(range, context->GetConversions().Convert(range, value * context->GetSensitivity(range)));
+}
@@ -0,0 +1,162 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Shared input contexts, and mapping for many players at once
+//
+
+#pragma once
+
+
+// Dependencies
+#include "RawInputConstants.h"
+#include "InputConstants.h"
+#include "InputBindings.h"
+#include "MappedInput.h"
+#include "RawInputQueue.h"
+#include "ParallelFor.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	// Forward declarations
+	class InputContext;
+	class InputIdentifierTable;
+	struct ContextSet;
+
+
+	//
+	// Everything one player needs to map input against a context library
+	//
+	// This is plain data with no pointers, sized only by the input constants,
+	// so large numbers of players can be kept in a single array and copied or
+	// snapshotted freely. Context handles refer to the library the player is
+	// mapped against. Resolved[N] records which of the bottom N + 1 contexts
+	// owns each raw input, so no event has to walk the stack; these tables
+	// are a couple of dozen bytes each, and the whole state stays under 1 KB.
+	//
+	struct PlayerInputState
+	{
+		static const unsigned MaxContextDepth = 8;
+
+		ContextHandle ActiveContexts[MaxContextDepth];
+		ResolvedBindings Resolved[MaxContextDepth];
+		unsigned ContextDepth;
+		unsigned HeldButtons;		// One bit per raw button currently down
+
+		MappedInput Mapped;
+
+		void Reset()
+		{
+			ContextDepth = 0;
+			HeldButtons = 0;
+			Mapped.Actions.reset();
+			Mapped.States.reset();
+			Mapped.Ranges.reset();
+		}
+	};
+
+
+	//
+	// Immutable set of loaded contexts shared by any number of players
+	//
+	// A library never changes once loaded, so it may be used from any number
+	// of threads at once; each player's mutable state lives entirely in its
+	// own PlayerInputState. Context handles are assigned in name order when
+	// the library is created.
+	//
+	// Players are mapped by the same per-context code as an InputMapper, so
+	// both always produce the same results. Combos and analog filter chains
+	// need per-player history which would be many times the size of the
+	// rest of the state, so contexts using them cannot be pushed onto a
+	// player; use an InputMapper for players which need them.
+	//
+	class ContextLibrary
+	{
+	// Construction
+	public:
+		explicit ContextLibrary(const std::shared_ptr<const ContextSet>& contexts);
+
+		static std::shared_ptr<const ContextLibrary> LoadText(const std::wstring& listfilename);
+		static std::shared_ptr<const ContextLibrary> LoadCompiled(const std::wstring& imagefilename);
+
+	// Context lookup interface
+	public:
+		ContextHandle GetContextHandle(const std::wstring& name) const;
+		const InputIdentifierTable& GetIdentifiers() const;
+
+		const std::shared_ptr<const ContextSet>& GetContexts() const
+		{ return Contexts; }
+
+	// Per-player mapping interface
+	public:
+		void PushContext(PlayerInputState& player, ContextHandle handle) const;
+		void PopContext(PlayerInputState& player) const;
+
+		void MapRawEvent(PlayerInputState& player, const RawInputEvent& event) const;
+		void MapRawButtonState(PlayerInputState& player, RawInputButton button, bool pressed, bool previouslypressed) const;
+		void MapRawAxisValue(PlayerInputState& player, RawInputAxis axis, double value) const;
+
+		// Like InputMapper::Clear(), states are left alone
+		static void ClearMappedInput(PlayerInputState& player)
+		{
+			player.Mapped.Actions.reset();
+			player.Mapped.Ranges.reset();
+		}
+
+	// Batch mapping interface
+	public:
+		//
+		// Map one tick of raw input for every player, spread across all cores
+		//
+		// Events for all players are given in one array, grouped by player:
+		// player N's events are [eventoffsets[N], eventoffsets[N + 1]), so the
+		// offset array holds playercount + 1 entries. Each player's mapped
+		// input is cleared, its events are mapped, and then dispatch(N, input)
+		// is called with the result. Players are processed in parallel on the
+		// given pool, which should be kept from tick to tick, so the dispatch
+		// functor will be called from several threads at once; calls for any
+		// one player are never concurrent.
+		//
+		template <typename DispatchT>
+		void MapPlayers(WorkerPool& workers, PlayerInputState* players, size_t playercount, const RawInputEvent* events, const size_t* eventoffsets, DispatchT dispatch) const
+		{
+			// Players are handed out in blocks, so each worker pulls from the
+			// shared counter once per block rather than once per player
+			const size_t blocksize = 64;
+
+			workers.ParallelFor((playercount + blocksize - 1) / blocksize, [&](size_t block)
+			{
+				size_t end = (block + 1) * blocksize;
+				if(end > playercount)
+					end = playercount;
+
+				for(size_t i = block * blocksize; i < end; ++i)
+				{
+					PlayerInputState& player = players[i];
+					ClearMappedInput(player);
+
+					for(size_t j = eventoffsets[i]; j < eventoffsets[i + 1]; ++j)
+						MapRawEvent(player, events[j]);
+
+					dispatch(i, player.Mapped);
+				}
+			});
+		}
+
+	// Internal tracking
+	private:
+		std::shared_ptr<const ContextSet> Contexts;
+		std::map<std::wstring, ContextHandle> ContextHandles;
+		std::vector<const InputContext*> ContextsByHandle;
+	};
+
+}
+
@@ -0,0 +1,163 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Immutable snapshot of every loaded input context
+//
+
+#include "pch.h"
+
+#include "ContextSet.h"
+#include "InputContext.h"
+#include "ContextImage.h"
+
+#include "FileIO.h"
+#include "ParallelFor.h"
+
+#include <vector>
+
+
+using namespace InputMapping;
+
+
+//
+// Look up a context by name; returns NULL if there is no such context
+//
+const InputContext* ContextSet::Find(const std::wstring& name) const
+{
+	EntryMapT::const_iterator iter = Entries.find(name);
+	if(iter == Entries.end())
+		return NULL;
+
+	return iter->second.Context.get();
+}
+
+
+//
+// Build a snapshot from a context list and the text context files it names
+//
+// The list may end with declarations of named identifiers; a count, and
+// then pairs of a kind (action, state, or range) and a name.
+//
+// Any context whose file name and modification time match an entry in the
+// previous snapshot is carried over as-is, provided the identifiers have
+// not changed either; everything else is parsed, with all changed files
+// loaded concurrently. If nothing at all has changed, no new snapshot is
+// built and NULL is returned.
+//
+std::shared_ptr<const ContextSet> ContextSet::LoadText(const std::wstring& listfilename, const ContextSet* previous)
+{
+	std::shared_ptr<ContextSet> ret(new ContextSet);
+	ret->ImageModificationTime = 0;
+
+	std::vector<std::wstring> names;
+	std::vector<std::wstring> files;
+	{
+		TextFileReader infile(listfilename);
+		unsigned count = AttemptRead<unsigned>(infile);
+		for(unsigned i = 0; i < count; ++i)
+		{
+			names.push_back(AttemptRead<std::wstring>(infile));
+			files.push_back(AttemptRead<std::wstring>(infile));
+		}
+
+		if(!infile.IsAtEnd())
+		{
+			unsigned identifiercount = AttemptRead<unsigned>(infile);
+			for(unsigned i = 0; i < identifiercount; ++i)
+			{
+				std::wstring kind = AttemptRead<std::wstring>(infile);
+				std::wstring name = AttemptRead<std::wstring>(infile);
+
+				if(kind == L"action")
+					ret->Identifiers.Declare(INPUT_IDENTIFIER_ACTION, name);
+				else if(kind == L"state")
+					ret->Identifiers.Declare(INPUT_IDENTIFIER_STATE, name);
+				else if(kind == L"range")
+					ret->Identifiers.Declare(INPUT_IDENTIFIER_RANGE, name);
+				else
+					throw std::runtime_error("Invalid identifier kind in context list");
+			}
+
+			ret->Identifiers.Build();
+		}
+	}
+
+	bool identifierschanged = !previous || previous->Identifiers != ret->Identifiers;
+
+	std::vector<std::wstring> changednames;
+	std::vector<std::wstring> changedfiles;
+	for(size_t i = 0; i < names.size(); ++i)
+	{
+		const std::wstring& name = names[i];
+		const std::wstring& file = files[i];
+
+		Entry entry;
+		entry.FileName = file;
+		entry.ModificationTime = GetFileModificationTime(file);
+
+		if(!identifierschanged)
+		{
+			EntryMapT::const_iterator iter = previous->Entries.find(name);
+			if(iter != previous->Entries.end() && iter->second.FileName == file && iter->second.ModificationTime == entry.ModificationTime)
+				entry.Context = iter->second.Context;
+		}
+
+		if(!entry.Context)
+		{
+			changednames.push_back(name);
+			changedfiles.push_back(file);
+		}
+
+		ret->Entries[name] = entry;
+	}
+
+	if(!identifierschanged && changednames.empty() && previous->Entries.size() == ret->Entries.size())
+		return std::shared_ptr<const ContextSet>();
+
+	// Context files are independent of each other, so parse them all
+	// concurrently; nothing is published unless every one loads
+	std::vector<std::shared_ptr<const InputContext> > contexts(changedfiles.size());
+	const InputIdentifierTable& identifiers = ret->Identifiers;
+	ParallelFor(changedfiles.size(), [&](size_t i)
+	{
+		contexts[i].reset(new InputContext(changedfiles[i], identifiers));
+	});
+
+	for(size_t i = 0; i < changednames.size(); ++i)
+		ret->Entries[changednames[i]].Context = contexts[i];
+
+	return ret;
+}
+
+//
+// Build a snapshot from a compiled context image
+//
+// Images are all-or-nothing, so if the image file has changed at all it is
+// mapped afresh and every context is rebuilt over it. If it has not changed
+// since the previous snapshot, NULL is returned.
+//
+std::shared_ptr<const ContextSet> ContextSet::LoadCompiled(const std::wstring& imagefilename, const ContextSet* previous)
+{
+	long long modificationtime = GetFileModificationTime(imagefilename);
+	if(previous && previous->Image && previous->ImageModificationTime == modificationtime)
+		return std::shared_ptr<const ContextSet>();
+
+	std::shared_ptr<ContextSet> ret(new ContextSet);
+	std::shared_ptr<CompiledContextImage> image(new CompiledContextImage(imagefilename));
+	ret->Image = image;
+	ret->ImageModificationTime = modificationtime;
+	image->LoadIdentifiers(ret->Identifiers);
+
+	for(unsigned i = 0; i < image->GetContextCount(); ++i)
+	{
+		Entry& entry = ret->Entries[image->GetContextName(i)];
+		entry.Context.reset(new InputContext(image->GetContextTables(i)));
+		entry.FileName = imagefilename;
+		entry.ModificationTime = modificationtime;
+	}
+
+	return ret;
+}
+
@@ -0,0 +1,66 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Immutable snapshot of every loaded input context
+//
+
+#pragma once
+
+
+// Dependencies
+#include "InputIdentifiers.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+
+namespace InputMapping
+{
+
+	// Forward declarations
+	class InputContext;
+	class CompiledContextImage;
+
+
+	//
+	// Immutable snapshot of every loaded input context
+	//
+	// A snapshot is never modified once it has been built; reloading builds a
+	// new snapshot from the previous one, reusing any context whose file has
+	// not changed, and the input mapper swaps the new snapshot in between two
+	// ticks. Contexts are held by shared pointer so that unchanged contexts
+	// can be shared between the old and new snapshots.
+	//
+	// Named identifiers are part of the snapshot too; if their declarations
+	// change, IDs may shift, so every context is reloaded along with them.
+	//
+	struct ContextSet
+	{
+		struct Entry
+		{
+			std::shared_ptr<const InputContext> Context;
+			std::wstring FileName;
+			long long ModificationTime;
+		};
+
+		typedef std::map<std::wstring, Entry> EntryMapT;
+
+		// Image must be declared before Entries, so that contexts which use
+		// its tables in place are destroyed before it is unmapped
+		std::shared_ptr<const CompiledContextImage> Image;
+		long long ImageModificationTime;
+
+		EntryMapT Entries;
+		InputIdentifierTable Identifiers;
+
+		const InputContext* Find(const std::wstring& name) const;
+
+		static std::shared_ptr<const ContextSet> LoadText(const std::wstring& listfilename, const ContextSet* previous);
+		static std::shared_ptr<const ContextSet> LoadCompiled(const std::wstring& imagefilename, const ContextSet* previous);
+	};
+
+}
+
@@ -0,0 +1,65 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Plain data tables describing a single input context
+//
+
+#pragma once
+
+
+// Dependencies
+#include "InputBindings.h"
+#include "InputConstants.h"
+#include "RangeConverter.h"
+#include "AnalogFilter.h"
+#include "ComboRecognizer.h"
+#include "ModifierBindings.h"
+
+
+namespace InputMapping
+{
+
+	//
+	// Serializable description of one analog filter stage
+	//
+	struct FilterStageDescription
+	{
+		unsigned Type;
+		double Parameter;
+	};
+
+
+	//
+	// Complete set of tables describing one input context
+	//
+	// This holds no pointers and needs no construction, so the very same
+	// bytes can be filled in by the text loader, written out into a compiled
+	// context image, and used in place once that image is mapped back into
+	// memory. Slots with nothing bound hold UnmappedBinding, ranges with no
+	// converter hold an identity conversion, and ranges with no sensitivity
+	// hold a sensitivity of 1. Combo steps and modifier sets are stored as
+	// masks of raw buttons, one bit per button.
+	//
+	struct ContextTables
+	{
+		ButtonBinding Buttons[RAW_INPUT_BUTTON_COUNT];
+		unsigned short Axes[RAW_INPUT_AXIS_COUNT];
+
+		double Sensitivities[RANGE_COUNT];
+		RangeConversion Conversions[RANGE_COUNT];
+
+		unsigned FilterStageCounts[RANGE_COUNT];
+		FilterStageDescription FilterStages[RANGE_COUNT][AnalogFilterState::MaxStages];
+
+		unsigned ComboCount;
+		ComboDescription Combos[ComboRecognizer::MaxCombos];
+		unsigned ComboStepButtons[ComboRecognizer::MaxSteps];
+
+		unsigned ModifierBindingCount;
+		ModifierBindingDescription ModifierBindings[ModifierBindingTable::MaxBindings];
+	};
+
+}
+
@@ -111,6 +111,17 @@ int APIENTRY wWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR, int showflag)
 	Mapper.PushContext(L"maincontext");
 	Mapper.AddCallback(InputCallback, 0);
 
+	// Mouse movement arrives as deltas, possibly many per tick; add
+	// them all up rather than keeping only the last one
+	Mapper.SetRawAxisMode(InputMapping::RAW_INPUT_AXIS_MOUSE_X, InputMapping::RAW_AXIS_MODE_SUM);
+	Mapper.SetRawAxisMode(InputMapping::RAW_INPUT_AXIS_MOUSE_Y, InputMapping::RAW_AXIS_MODE_SUM);
+
+	// Pick up edits to the context files while the demo is running
+	Mapper.WatchContextFiles(500);
+
+	// Show how long input waits between arriving and being handled
+	Mapper.EnableLatencyTracking(true);
+
 	
 	// Message pump
 	MSG msg;
@@ -174,6 +185,20 @@ namespace
 		return true;
 	}
 
+	//
+	// Helper for stamping the message being handled with the time it was
+	// posted, rather than the time the window procedure got around to it
+	//
+	// GetMessageTime() is in milliseconds on the GetTickCount() clock, so
+	// the message's age is measured on that clock and taken off the input
+	// clock's current time.
+	//
+	InputMapping::InputTimestamp GetMessageTimestamp()
+	{
+		DWORD age = ::GetTickCount() - static_cast<DWORD>(::GetMessageTime());
+		return InputMapping::GetInputTimestamp() - static_cast<InputMapping::InputTimestamp>(age) * 1000;
+	}
+
 	//
 	// Internal helper for appending to the scrolling log lines
 	//
@@ -211,9 +236,6 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wparam, LPARAM lparam)
 
 	case WM_PAINT:
 		{
-			Mapper.Dispatch();
-			Mapper.Clear();
-
 			PAINTSTRUCT ps;
 			HDC hdc = ::BeginPaint(hWnd, &ps);
 
@@ -225,6 +247,8 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wparam, LPARAM lparam)
 			display << L"\nState 1: " << (StateOne ? L"Y" : L"N") << "    ";
 			display << L"State 2: " << (StateTwo ? L"Y" : L"N") << "    ";
 			display << L"State 3: " << (StateThree ? L"Y" : L"N") << "\n";
+			display << L"Input latency: " << Mapper.GetEventLatency().GetPercentile(0.5) / 1000 << L" us median, ";
+			display << Mapper.GetEventLatency().GetPercentile(0.99) / 1000 << L" us 99th percentile\n";
 			display << L"\n\n\n" << LogLine1 << L"\n";
 			display << LogLine2 << L"\n";
 			display << LogLine3 << L"\n";
@@ -245,6 +269,17 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wparam, LPARAM lparam)
 	case WM_TIMER:
 		if(wparam == TIMER_REDRAW)
 		{
+			// Simulation tick: map everything queued since the last
+			// tick in one batch, then hand it out to the callbacks.
+			// Callbacks don't run on ticks with no input at all, so
+			// the display starts each tick showing nothing held.
+			AxisX = AxisY = 0.0;
+			StateOne = StateTwo = StateThree = false;
+
+			Mapper.ProcessQueuedInput();
+			Mapper.Dispatch();
+			Mapper.Clear();
+
 			::InvalidateRect(hWnd, NULL, TRUE);
 			::SetTimer(hWnd, TIMER_REDRAW, 50, NULL);
 		}
@@ -260,8 +295,9 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wparam, LPARAM lparam)
 			int x = LOWORD(lparam);
 			int y = HIWORD(lparam);
 
-			Mapper.SetRawAxisValue(InputMapping::RAW_INPUT_AXIS_MOUSE_X, static_cast<double>(x - LastX));
-			Mapper.SetRawAxisValue(InputMapping::RAW_INPUT_AXIS_MOUSE_Y, static_cast<double>(y - LastY));
+			InputMapping::InputTimestamp timestamp = GetMessageTimestamp();
+			Mapper.QueueRawAxisValue(InputMapping::RAW_INPUT_AXIS_MOUSE_X, static_cast<double>(x - LastX), timestamp);
+			Mapper.QueueRawAxisValue(InputMapping::RAW_INPUT_AXIS_MOUSE_Y, static_cast<double>(y - LastY), timestamp);
 
 			LastX = x;
 			LastY = y;
@@ -274,7 +310,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wparam, LPARAM lparam)
 			bool previouslydown = ((lparam & (1 << 31)) != 0);
 
 			if(ConvertWParamToRawButton(wparam, button))
-				Mapper.SetRawButtonState(button, true, previouslydown);
+				Mapper.QueueRawButtonState(button, true, previouslydown, GetMessageTimestamp());
 		}
 		break;
 
@@ -282,7 +318,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wparam, LPARAM lparam)
 		{
 			InputMapping::RawInputButton button;
 			if(ConvertWParamToRawButton(wparam, button))
-				Mapper.SetRawButtonState(button, false, true);
+				Mapper.QueueRawButtonState(button, false, true, GetMessageTimestamp());
 		}
 		break;
 	}
@@ -319,32 +355,32 @@ INT_PTR CALLBACK About(HWND hDlg, UINT msg, WPARAM wparam, LPARAM)
 //
 void InputCallback(InputMapping::MappedInput& inputs)
 {
-	AxisX = inputs.Ranges[InputMapping::RANGE_ONE];
-	AxisY = inputs.Ranges[InputMapping::RANGE_TWO];
+	AxisX = inputs.GetRange(InputMapping::RANGE_ONE);
+	AxisY = inputs.GetRange(InputMapping::RANGE_TWO);
 
-	StateOne = inputs.States.find(InputMapping::STATE_ONE) != inputs.States.end();
-	StateTwo = inputs.States.find(InputMapping::STATE_TWO) != inputs.States.end();
-	StateThree = inputs.States.find(InputMapping::STATE_THREE) != inputs.States.end();
+	StateOne = inputs.HasState(InputMapping::STATE_ONE);
+	StateTwo = inputs.HasState(InputMapping::STATE_TWO);
+	StateThree = inputs.HasState(InputMapping::STATE_THREE);
 
-	if(inputs.Actions.find(InputMapping::ACTION_ONE) != inputs.Actions.end())
+	if(inputs.HasAction(InputMapping::ACTION_ONE))
 		PushLogLine(L"Action 1 fired!");
 
-	if(inputs.Actions.find(InputMapping::ACTION_TWO) != inputs.Actions.end())
+	if(inputs.HasAction(InputMapping::ACTION_TWO))
 		PushLogLine(L"Action 2 fired!");
 
-	if(inputs.Actions.find(InputMapping::ACTION_THREE) != inputs.Actions.end())
+	if(inputs.HasAction(InputMapping::ACTION_THREE))
 		PushLogLine(L"Action 3 fired!");
 
-	if(inputs.Actions.find(InputMapping::ACTION_FOUR) != inputs.Actions.end())
+	if(inputs.HasAction(InputMapping::ACTION_FOUR))
 		PushLogLine(L"Action 4 fired!");
 
-	if(inputs.Actions.find(InputMapping::ACTION_FIVE) != inputs.Actions.end())
+	if(inputs.HasAction(InputMapping::ACTION_FIVE))
 		PushLogLine(L"Action 5 fired!");
 
-	if(inputs.Actions.find(InputMapping::ACTION_SIX) != inputs.Actions.end())
+	if(inputs.HasAction(InputMapping::ACTION_SIX))
 		PushLogLine(L"Action 6 fired!");
 
-	if(inputs.Actions.find(InputMapping::ACTION_SEVEN) != inputs.Actions.end())
+	if(inputs.HasAction(InputMapping::ACTION_SEVEN))
 		PushLogLine(L"Action 7 fired!");
 }
 
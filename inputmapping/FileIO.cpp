@@ -0,0 +1,180 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Helper functions for file I/O
+//
+
+#include "pch.h"
+
+#include "FileIO.h"
+
+#include <charconv>
+#include <cstdio>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+
+//
+// Internal helpers
+//
+namespace
+{
+	bool IsWhitespace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+	}
+}
+
+
+//
+// Retrieve a file's last modification time
+//
+long long GetFileModificationTime(const std::wstring& filename)
+{
+#ifdef WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if(!::GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &attributes))
+		return 0;
+
+	return (static_cast<long long>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat info;
+	if(::stat(NarrowFileName(filename).c_str(), &info) != 0)
+		return 0;
+
+	return (static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL) + info.st_mtim.tv_nsec;
+#endif
+}
+
+
+//
+// Retrieve the name under which a file's new contents are written
+//
+std::wstring GetReplacementFileName(const std::wstring& filename)
+{
+	return filename + L".tmp";
+}
+
+//
+// Move a fully written replacement file over the original
+//
+void CommitReplacementFile(const std::wstring& filename)
+{
+	std::wstring replacement = GetReplacementFileName(filename);
+
+#ifdef WIN32
+	if(!::MoveFileEx(replacement.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+	if(std::rename(NarrowFileName(replacement).c_str(), NarrowFileName(filename).c_str()) != 0)
+#endif
+	{
+		DiscardReplacementFile(filename);
+		throw std::runtime_error("Failed to replace file; it may be in use");
+	}
+}
+
+//
+// Remove a replacement file which will not be committed
+//
+void DiscardReplacementFile(const std::wstring& filename)
+{
+#ifdef WIN32
+	::DeleteFile(GetReplacementFileName(filename).c_str());
+#else
+	std::remove(NarrowFileName(GetReplacementFileName(filename)).c_str());
+#endif
+}
+
+
+//
+// Read the entire contents of a file into memory
+//
+TextFileReader::TextFileReader(const std::wstring& filename)
+	: Position(0)
+{
+#ifdef WIN32
+	FILE* file = ::_wfopen(filename.c_str(), L"rb");
+#else
+	FILE* file = std::fopen(NarrowFileName(filename).c_str(), "rb");
+#endif
+	if(!file)
+		throw std::runtime_error("Failed to open file for reading");
+
+	std::fseek(file, 0, SEEK_END);
+	long size = std::ftell(file);
+	std::fseek(file, 0, SEEK_SET);
+
+	if(size > 0)
+	{
+		Buffer.resize(static_cast<size_t>(size));
+		if(std::fread(&Buffer[0], 1, Buffer.size(), file) != Buffer.size())
+		{
+			std::fclose(file);
+			throw std::runtime_error("Failed to read file contents");
+		}
+	}
+
+	std::fclose(file);
+}
+
+
+//
+// Retrieve the next whitespace-delimited token, if any remain
+//
+bool TextFileReader::ReadToken(const char*& begin, const char*& end)
+{
+	if(IsAtEnd())
+		return false;
+
+	size_t start = Position;
+	while(Position < Buffer.size() && !IsWhitespace(Buffer[Position]))
+		++Position;
+
+	begin = &Buffer[0] + start;
+	end = &Buffer[0] + Position;
+	return true;
+}
+
+//
+// Skip any whitespace and determine whether the file has been exhausted
+//
+bool TextFileReader::IsAtEnd()
+{
+	while(Position < Buffer.size() && IsWhitespace(Buffer[Position]))
+		++Position;
+
+	return Position >= Buffer.size();
+}
+
+
+//
+// Convert a token into an unsigned integer; the entire token must be consumed
+//
+bool ParseToken(const char* begin, const char* end, unsigned& out)
+{
+	std::from_chars_result result = std::from_chars(begin, end, out);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+//
+// Convert a token into a double; the entire token must be consumed
+//
+bool ParseToken(const char* begin, const char* end, double& out)
+{
+	std::from_chars_result result = std::from_chars(begin, end, out);
+	return result.ec == std::errc() && result.ptr == end;
+}
+
+//
+// Convert a token into a wide string
+//
+bool ParseToken(const char* begin, const char* end, std::wstring& out)
+{
+	out.assign(begin, end);
+	return true;
+}
+
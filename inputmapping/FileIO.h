@@ -9,18 +9,94 @@
 #pragma once
 
 // Dependencies
-#include <istream>
+#include <string>
+#include <vector>
+#include <stdexcept>
 
 
 //
-// Helper for attempting to read from a file (or other istream-compatible interface)
+// Helper for converting a file name to the narrow form required by non-Windows file APIs
+//
+// File names used by the demo are plain ASCII, so no real transcoding is attempted.
+//
+inline std::string NarrowFileName(const std::wstring& filename)
+{
+	std::string ret;
+	ret.reserve(filename.size());
+	for(std::wstring::const_iterator iter = filename.begin(); iter != filename.end(); ++iter)
+		ret.push_back(static_cast<char>(*iter));
+
+	return ret;
+}
+
+
+//
+// Helper for retrieving a file's last modification time, in arbitrary but
+// consistent units; returns 0 if the file cannot be examined
+//
+long long GetFileModificationTime(const std::wstring& filename);
+
+
+//
+// Helpers for replacing a file without ever leaving it partly written
+//
+// New contents are written to the replacement file name, next to the file
+// itself, and then renamed over the original in a single step. Anyone who
+// already has the old file open or mapped keeps seeing the old contents;
+// anyone opening it afterwards sees the new.
+//
+std::wstring GetReplacementFileName(const std::wstring& filename);
+void CommitReplacementFile(const std::wstring& filename);
+void DiscardReplacementFile(const std::wstring& filename);
+
+
+//
+// Whitespace-separated token reader over the entire contents of a text file
+//
+// The file is pulled into memory with a single bulk read, and tokens are
+// handed out as ranges within that buffer; numbers are then converted with
+// std::from_chars, which avoids the locale and per-character stream costs
+// of extracting values from a std::wistream.
+//
+class TextFileReader
+{
+// Construction
+public:
+	explicit TextFileReader(const std::wstring& filename);
+
+// Token interface
+public:
+	bool ReadToken(const char*& begin, const char*& end);
+	bool IsAtEnd();
+
+// Internal tracking
+private:
+	std::vector<char> Buffer;
+	size_t Position;
+};
+
+
+//
+// Helpers for converting a single token into a value
+//
+bool ParseToken(const char* begin, const char* end, unsigned& out);
+bool ParseToken(const char* begin, const char* end, double& out);
+bool ParseToken(const char* begin, const char* end, std::wstring& out);
+
+
+//
+// Helper for attempting to read from a file
 //
 template <typename OutType>
-OutType AttemptRead(std::wistream& stream)
+OutType AttemptRead(TextFileReader& reader)
 {
+	const char* begin;
+	const char* end;
+
 	OutType out;
-	if(!(stream >> out))
-		throw std::exception("Failed to read a required value");
+	if(!reader.ReadToken(begin, end) || !ParseToken(begin, end, out))
+		throw std::runtime_error("Failed to read a required value");
 
 	return out;
 }
+
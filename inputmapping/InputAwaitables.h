@@ -0,0 +1,166 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// C++20 coroutine awaitables for waiting on mapped input
+//
+
+#pragma once
+
+
+// Dependencies
+#include "InputWaiters.h"
+
+#include <chrono>
+
+
+// Coroutine support is only compiled in where the compiler provides it
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define INPUTMAPPING_HAS_COROUTINES
+#endif
+#endif
+
+
+#ifdef INPUTMAPPING_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+
+
+namespace InputMapping
+{
+
+	//
+	// Common base for awaitables which suspend a coroutine on an input waiter
+	//
+	// The waiter lives inside the awaitable, which in turn lives in the
+	// coroutine frame for the duration of the co_await, so waiting never
+	// allocates. If the coroutine is destroyed while suspended, the wait is
+	// cancelled along with it.
+	//
+	class InputAwaitable
+	{
+	// Construction and destruction
+	public:
+		explicit InputAwaitable(InputWaiterIndex& index)
+			: Index(index)
+		{
+		}
+
+		~InputAwaitable()
+		{
+			InputWaiterIndex::Cancel(Waiter);
+		}
+
+		InputAwaitable(const InputAwaitable&) = delete;
+		InputAwaitable& operator = (const InputAwaitable&) = delete;
+
+	// Awaitable interface
+	public:
+		bool await_ready() const
+		{ return false; }
+
+		void await_resume() const
+		{ }
+
+	// Internal helpers
+	protected:
+		void Prepare(std::coroutine_handle<> coroutine)
+		{
+			Waiter.Resume = &ResumeCoroutine;
+			Waiter.Context = coroutine.address();
+		}
+
+		static void ResumeCoroutine(void* address)
+		{ std::coroutine_handle<>::from_address(address).resume(); }
+
+	// Internal tracking
+	protected:
+		InputWaiterIndex& Index;
+		InputWaiter Waiter;
+	};
+
+
+	//
+	// Awaitable which resumes on the next tick an action fires
+	//
+	class ActionAwaitable : public InputAwaitable
+	{
+	public:
+		ActionAwaitable(InputWaiterIndex& index, Action action)
+			: InputAwaitable(index),
+			  AwaitedAction(action)
+		{
+		}
+
+		void await_suspend(std::coroutine_handle<> coroutine)
+		{
+			Prepare(coroutine);
+			Index.WaitForAction(AwaitedAction, Waiter);
+		}
+
+	private:
+		Action AwaitedAction;
+	};
+
+
+	//
+	// Awaitable which resumes once a state has been held for a given time
+	//
+	class StateHeldAwaitable : public InputAwaitable
+	{
+	public:
+		StateHeldAwaitable(InputWaiterIndex& index, State state, InputTimestamp duration)
+			: InputAwaitable(index),
+			  AwaitedState(state),
+			  Duration(duration)
+		{
+		}
+
+		void await_suspend(std::coroutine_handle<> coroutine)
+		{
+			Prepare(coroutine);
+			Index.WaitForStateHeld(AwaitedState, Duration, Waiter);
+		}
+
+	private:
+		State AwaitedState;
+		InputTimestamp Duration;
+	};
+
+
+	//
+	// Minimal fire-and-forget coroutine type for input scripts
+	//
+	// The coroutine starts running immediately, and its frame is freed when
+	// it finishes. Engines with their own task types can use the awaitables
+	// above from those instead.
+	//
+	struct InputScript
+	{
+		struct promise_type
+		{
+			InputScript get_return_object()				{ return InputScript(); }
+			std::suspend_never initial_suspend()		{ return std::suspend_never(); }
+			std::suspend_never final_suspend() noexcept	{ return std::suspend_never(); }
+			void return_void()							{ }
+			void unhandled_exception()					{ std::terminate(); }
+		};
+	};
+
+
+	//
+	// Helper for converting a duration into input timestamp units
+	//
+	template <typename Rep, typename Period>
+	InputTimestamp ToInputTimestamp(std::chrono::duration<Rep, Period> duration)
+	{
+		return static_cast<InputTimestamp>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+	}
+
+}
+
+#endif
+
@@ -0,0 +1,82 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Flat binding tables shared by input contexts and the input mapper
+//
+
+#pragma once
+
+
+// Dependencies
+#include "RawInputConstants.h"
+#include "InputConstants.h"
+
+#include <cstddef>
+
+
+namespace InputMapping
+{
+
+	//
+	// Sentinel stored in any binding slot that has no mapping
+	//
+	const unsigned short UnmappedBinding = 0xffff;
+
+	static_assert(ACTION_COUNT < UnmappedBinding && STATE_COUNT < UnmappedBinding && RANGE_COUNT < UnmappedBinding, "Identifier capacities must fit in a binding slot");
+
+
+	// Handy type shortcuts
+	typedef unsigned ContextHandle;
+
+
+	//
+	// Handle returned when looking up a context name which was never loaded
+	//
+	const ContextHandle InvalidContextHandle = 0xffffffff;
+
+
+	//
+	// Action and state bound to a single raw button
+	//
+	struct ButtonBinding
+	{
+		unsigned short MappedAction;
+		unsigned short MappedState;
+	};
+
+
+	//
+	// Sentinel stored in any resolved slot which no active context binds
+	//
+	const unsigned short NoBindingOwner = 0xffff;
+
+
+	//
+	// Owners of every raw input across an entire stack of input contexts
+	//
+	// Each slot holds the stack depth of the topmost context that binds the
+	// given raw input in any way, whether plainly, with modifiers, or as a
+	// combo step. That context hides every binding of the input in contexts
+	// beneath it, so a raw event is resolved with a single lookup followed by
+	// the owning context's own tables. Only depths are kept, rather than the bindings
+	// themselves, so a table can cheaply be kept per stack depth.
+	//
+	struct ResolvedBindings
+	{
+		unsigned short ButtonOwners[RAW_INPUT_BUTTON_COUNT];
+		unsigned short AxisOwners[RAW_INPUT_AXIS_COUNT];
+
+		void Reset()
+		{
+			for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+				ButtonOwners[i] = NoBindingOwner;
+
+			for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+				AxisOwners[i] = NoBindingOwner;
+		}
+	};
+
+}
+
@@ -9,9 +9,40 @@
 #pragma once
 
 
+// Capacity for identifiers of each kind, including those declared in data;
+// define these before including any input mapping header to change them.
+//
+// Every mapped input record is sized by these, however many identifiers
+// the data actually declares: each action or state costs one bit in
+// MappedInput, InputInterest, the published snapshot, and every
+// PlayerInputState, and each range costs one bit plus an 8-byte value.
+// The defaults come to under 700 bytes per MappedInput, most of it range
+// values. Builds with tighter budgets can lower them to what their data
+// needs, and loading data which declares more fails with an error.
+#ifndef INPUTMAPPING_MAX_ACTIONS
+#define INPUTMAPPING_MAX_ACTIONS 1024
+#endif
+
+#ifndef INPUTMAPPING_MAX_STATES
+#define INPUTMAPPING_MAX_STATES 256
+#endif
+
+#ifndef INPUTMAPPING_MAX_RANGES
+#define INPUTMAPPING_MAX_RANGES 64
+#endif
+
+
 namespace InputMapping
 {
 
+	//
+	// Built-in identifiers, which code can refer to directly
+	//
+	// Further identifiers of each kind may be declared by name in the
+	// context list (see InputIdentifiers.h), and are numbered after the
+	// built-in ones. The *_COUNT values are the capacity for each kind,
+	// which is what all per-ID tables and bitsets are sized by.
+	//
 	enum Action
 	{
 		ACTION_ONE,
@@ -21,6 +52,9 @@ namespace InputMapping
 		ACTION_FIVE,
 		ACTION_SIX,
 		ACTION_SEVEN,
+
+		ACTION_BUILTIN_COUNT,
+		ACTION_COUNT = INPUTMAPPING_MAX_ACTIONS
 	};
 
 	enum State
@@ -28,12 +62,18 @@ namespace InputMapping
 		STATE_ONE,
 		STATE_TWO,
 		STATE_THREE,
+
+		STATE_BUILTIN_COUNT,
+		STATE_COUNT = INPUTMAPPING_MAX_STATES
 	};
 
 	enum Range
 	{
 		RANGE_ONE,
 		RANGE_TWO,
+
+		RANGE_BUILTIN_COUNT,
+		RANGE_COUNT = INPUTMAPPING_MAX_RANGES
 	};
 
 }
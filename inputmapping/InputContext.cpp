@@ -11,61 +11,246 @@
 
 #include "FileIO.h"
 
-#include <fstream>
-
 
 using namespace InputMapping;
 
 
 //
-// Construct and initialize an input context given data in a file
+// Internal helpers
 //
-InputContext::InputContext(const std::wstring& contextfilename)
-	: Conversions(NULL)
+namespace
 {
-	std::wifstream infile(contextfilename.c_str());
+	//
+	// Helper for reading an ID from a context file and ensuring it fits in the dense tables
+	//
+	template <typename IDType>
+	IDType ReadID(TextFileReader& infile, unsigned count)
+	{
+		unsigned id = AttemptRead<unsigned>(infile);
+		if(id >= count)
+			throw std::runtime_error("Out of range input ID in context file");
 
-	unsigned rangecount = AttemptRead<unsigned>(infile);
-	for(unsigned i = 0; i < rangecount; ++i)
+		return static_cast<IDType>(id);
+	}
+
+	//
+	// Helper for reading a set of raw buttons, given as a single raw button
+	// or several joined with '+', e.g. "3+4"; a lone '-' is the empty set
+	//
+	unsigned ReadButtonMask(TextFileReader& infile, bool allowempty)
 	{
-		RawInputAxis axis = static_cast<RawInputAxis>(AttemptRead<unsigned>(infile));
-		Range range = static_cast<Range>(AttemptRead<unsigned>(infile));
-		RangeMap[axis] = range;
+		const char* begin;
+		const char* end;
+		if(!infile.ReadToken(begin, end))
+			throw std::runtime_error("Failed to read a required value");
+
+		if(allowempty && end - begin == 1 && *begin == '-')
+			return 0;
+
+		unsigned buttons = 0;
+		while(begin < end)
+		{
+			const char* separator = begin;
+			while(separator < end && *separator != '+')
+				++separator;
+
+			unsigned button;
+			if(!ParseToken(begin, separator, button))
+				throw std::runtime_error("Failed to read a required value");
+
+			if(button >= RAW_INPUT_BUTTON_COUNT)
+				throw std::runtime_error("Out of range input ID in context file");
+
+			buttons |= 1u << button;
+			begin = (separator < end) ? separator + 1 : end;
+		}
+
+		if(!buttons)
+			throw std::runtime_error("Failed to read a required value");
+
+		return buttons;
 	}
+}
+
 
-	unsigned statecount = AttemptRead<unsigned>(infile);
-	for(unsigned i = 0; i < statecount; ++i)
+//
+// Construct and initialize an input context given data in a file
+//
+// Actions, states, and ranges may be given by name or ID; names are
+// resolved against the given identifier table.
+//
+InputContext::InputContext(const std::wstring& contextfilename, const InputIdentifierTable& identifiers)
+	: OwnedTables(new ContextTables()),
+	  Tables(OwnedTables),
+	  Conversions(OwnedTables->Conversions),
+	  BoundButtons(0),
+	  FilteredRangeCount(0)
+{
+	for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
 	{
-		RawInputButton button = static_cast<RawInputButton>(AttemptRead<unsigned>(infile));
-		State state = static_cast<State>(AttemptRead<unsigned>(infile));
-		StateMap[button] = state;
+		OwnedTables->Buttons[i].MappedAction = UnmappedBinding;
+		OwnedTables->Buttons[i].MappedState = UnmappedBinding;
 	}
 
-	unsigned actioncount = AttemptRead<unsigned>(infile);
-	for(unsigned i = 0; i < actioncount; ++i)
+	for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+		OwnedTables->Axes[i] = UnmappedBinding;
+
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
 	{
-		RawInputButton button = static_cast<RawInputButton>(AttemptRead<unsigned>(infile));
-		Action action = static_cast<Action>(AttemptRead<unsigned>(infile));
-		ActionMap[button] = action;
+		OwnedTables->Sensitivities[i] = 1.0;
+		OwnedTables->Conversions[i] = RangeConverter::GetIdentityConversion();
+		OwnedTables->FilterStageCounts[i] = 0;
 	}
 
-	Conversions = new RangeConverter(infile);
+	try
+	{
+		TextFileReader infile(contextfilename);
+
+		unsigned rangecount = AttemptRead<unsigned>(infile);
+		for(unsigned i = 0; i < rangecount; ++i)
+		{
+			RawInputAxis axis = ReadID<RawInputAxis>(infile, RAW_INPUT_AXIS_COUNT);
+			Range range = static_cast<Range>(ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_RANGE));
+			OwnedTables->Axes[axis] = static_cast<unsigned short>(range);
+		}
+
+		unsigned statecount = AttemptRead<unsigned>(infile);
+		for(unsigned i = 0; i < statecount; ++i)
+		{
+			RawInputButton button = ReadID<RawInputButton>(infile, RAW_INPUT_BUTTON_COUNT);
+			State state = static_cast<State>(ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_STATE));
+			OwnedTables->Buttons[button].MappedState = static_cast<unsigned short>(state);
+		}
+
+		unsigned actioncount = AttemptRead<unsigned>(infile);
+		for(unsigned i = 0; i < actioncount; ++i)
+		{
+			RawInputButton button = ReadID<RawInputButton>(infile, RAW_INPUT_BUTTON_COUNT);
+			Action action = static_cast<Action>(ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_ACTION));
+			OwnedTables->Buttons[button].MappedAction = static_cast<unsigned short>(action);
+		}
+
+		RangeConverter::LoadConversions(infile, identifiers, OwnedTables->Conversions);
+
+		unsigned sensitivitycount = AttemptRead<unsigned>(infile);
+		for(unsigned i = 0; i < sensitivitycount; ++i)
+		{
+			Range range = static_cast<Range>(ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_RANGE));
+			double sensitivity = AttemptRead<double>(infile);
+			OwnedTables->Sensitivities[range] = sensitivity;
+		}
+
+		// Filter chains are optional, so older context files may simply end here
+		if(!infile.IsAtEnd())
+		{
+			unsigned filtercount = AttemptRead<unsigned>(infile);
+			for(unsigned i = 0; i < filtercount; ++i)
+			{
+				Range range = static_cast<Range>(ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_RANGE));
+				unsigned type = ReadID<unsigned>(infile, ANALOG_FILTER_TYPE_COUNT);
+				double parameter = AttemptRead<double>(infile);
 
-	unsigned sensitivitycount = AttemptRead<unsigned>(infile);
-	for(unsigned i = 0; i < sensitivitycount; ++i)
+				unsigned& stagecount = OwnedTables->FilterStageCounts[range];
+				if(stagecount >= AnalogFilterState::MaxStages)
+					throw std::runtime_error("Too many filter stages specified for a single range");
+
+				OwnedTables->FilterStages[range][stagecount].Type = type;
+				OwnedTables->FilterStages[range][stagecount].Parameter = parameter;
+				++stagecount;
+			}
+		}
+
+		// Combos are likewise optional, and follow the filter chains
+		if(!infile.IsAtEnd())
+		{
+			unsigned combocount = AttemptRead<unsigned>(infile);
+			if(combocount > ComboRecognizer::MaxCombos)
+				throw std::runtime_error("Too many combos specified for a single context");
+
+			unsigned stepcount = 0;
+			for(unsigned i = 0; i < combocount; ++i)
+			{
+				ComboDescription& combo = OwnedTables->Combos[i];
+				combo.Action = ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_ACTION);
+				combo.WindowMilliseconds = AttemptRead<unsigned>(infile);
+				combo.FirstStep = stepcount;
+				combo.StepCount = AttemptRead<unsigned>(infile);
+
+				if(combo.StepCount == 0 || combo.StepCount > ComboRecognizer::MaxSteps - stepcount)
+					throw std::runtime_error("Too many combo steps specified for a single context");
+
+				for(unsigned j = 0; j < combo.StepCount; ++j)
+					OwnedTables->ComboStepButtons[stepcount++] = ReadButtonMask(infile, false);
+			}
+
+			OwnedTables->ComboCount = combocount;
+		}
+
+		// Modifier bindings are the last optional section
+		if(!infile.IsAtEnd())
+		{
+			unsigned bindingcount = AttemptRead<unsigned>(infile);
+			if(bindingcount > ModifierBindingTable::MaxBindings)
+				throw std::runtime_error("Too many modifier bindings specified for a single context");
+
+			for(unsigned i = 0; i < bindingcount; ++i)
+			{
+				ModifierBindingDescription& binding = OwnedTables->ModifierBindings[i];
+				binding.Button = ReadID<unsigned>(infile, RAW_INPUT_BUTTON_COUNT);
+				binding.RequiredButtons = ReadButtonMask(infile, true);
+				binding.ExcludedButtons = ReadButtonMask(infile, true);
+				binding.MappedAction = UnmappedBinding;
+				binding.MappedState = UnmappedBinding;
+
+				std::wstring kind = AttemptRead<std::wstring>(infile);
+				if(kind == L"action")
+					binding.MappedAction = static_cast<unsigned short>(ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_ACTION));
+				else if(kind == L"state")
+					binding.MappedState = static_cast<unsigned short>(ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_STATE));
+				else
+					throw std::runtime_error("Invalid output kind in modifier binding");
+			}
+
+			OwnedTables->ModifierBindingCount = bindingcount;
+		}
+
+		BuildFilterChains();
+		Combos.Build(Tables->Combos, Tables->ComboCount, Tables->ComboStepButtons);
+		ModifierBindings.Build(Tables->ModifierBindings, Tables->ModifierBindingCount);
+		FindBoundButtons();
+	}
+	catch(...)
 	{
-		Range range = static_cast<Range>(AttemptRead<unsigned>(infile));
-		double sensitivity = AttemptRead<double>(infile);
-		SensitivityMap[range] = sensitivity;
+		delete OwnedTables;
+		throw;
 	}
 }
 
+//
+// Construct an input context which uses a set of compiled tables in place
+//
+// The tables are not copied, so they must outlive the context.
+//
+InputContext::InputContext(const ContextTables& compiledtables)
+	: OwnedTables(NULL),
+	  Tables(&compiledtables),
+	  Conversions(compiledtables.Conversions),
+	  BoundButtons(0),
+	  FilteredRangeCount(0)
+{
+	ValidateTables();
+	BuildFilterChains();
+	Combos.Build(Tables->Combos, Tables->ComboCount, Tables->ComboStepButtons);
+	ModifierBindings.Build(Tables->ModifierBindings, Tables->ModifierBindingCount);
+	FindBoundButtons();
+}
+
 //
 // Destruct and clean up an input context
 //
 InputContext::~InputContext()
 {
-	delete Conversions;
+	delete OwnedTables;
 }
 
 
@@ -74,11 +259,11 @@ InputContext::~InputContext()
 //
 bool InputContext::MapButtonToAction(RawInputButton button, Action& out) const
 {
-	std::map<RawInputButton, Action>::const_iterator iter = ActionMap.find(button);
-	if(iter == ActionMap.end())
+	unsigned short action = Tables->Buttons[button].MappedAction;
+	if(action == UnmappedBinding)
 		return false;
 
-	out = iter->second;
+	out = static_cast<Action>(action);
 	return true;
 }
 
@@ -87,11 +272,11 @@ bool InputContext::MapButtonToAction(RawInputButton button, Action& out) const
 //
 bool InputContext::MapButtonToState(RawInputButton button, State& out) const
 {
-	std::map<RawInputButton, State>::const_iterator iter = StateMap.find(button);
-	if(iter == StateMap.end())
+	unsigned short state = Tables->Buttons[button].MappedState;
+	if(state == UnmappedBinding)
 		return false;
 
-	out = iter->second;
+	out = static_cast<State>(state);
 	return true;
 }
 
@@ -100,11 +285,11 @@ bool InputContext::MapButtonToState(RawInputButton button, State& out) const
 //
 bool InputContext::MapAxisToRange(RawInputAxis axis, Range& out) const
 {
-	std::map<RawInputAxis, Range>::const_iterator iter = RangeMap.find(axis);
-	if(iter == RangeMap.end())
+	unsigned short range = Tables->Axes[axis];
+	if(range == UnmappedBinding)
 		return false;
 
-	out = iter->second;
+	out = static_cast<Range>(range);
 	return true;
 }
 
@@ -114,10 +299,152 @@ bool InputContext::MapAxisToRange(RawInputAxis axis, Range& out) const
 //
 double InputContext::GetSensitivity(Range range) const
 {
-	std::map<Range, double>::const_iterator iter = SensitivityMap.find(range);
-	if(iter == SensitivityMap.end())
-		return 1.0;
+	return Tables->Sensitivities[range];
+}
+
+
+//
+// Map a raw button state change through this context's bindings
+//
+// This is shared by everything which maps input, so that an InputMapper
+// and a ContextLibrary always agree. Modifier bindings are more specific
+// than plain ones, so when any of them match, the plain bindings of the
+// button are skipped. Releasing the button eats every output it could
+// have mapped to, whatever the modifiers.
+//
+void InputContext::MapButton(MappedInput& mapped, RawInputButton button, bool pressed, bool previouslypressed, unsigned heldbuttons) const
+{
+	if(ModifierBindings.HasBindings(button))
+	{
+		if(pressed)
+		{
+			bool newlypressed = !previouslypressed;
+			unsigned matched = ModifierBindings.Match(button, heldbuttons, [&mapped, newlypressed](unsigned short action, unsigned short state)
+			{
+				if(newlypressed && action != UnmappedBinding)
+					mapped.SetAction(static_cast<Action>(action));
 
-	return iter->second;
+				if(state != UnmappedBinding)
+					mapped.SetState(static_cast<State>(state));
+			});
+
+			if(matched)
+				return;
+		}
+		else
+		{
+			ModifierBindings.MatchAnyModifiers(button, [&mapped](unsigned short action, unsigned short state)
+			{
+				if(action != UnmappedBinding)
+					mapped.EatAction(static_cast<Action>(action));
+
+				if(state != UnmappedBinding)
+					mapped.EatState(static_cast<State>(state));
+			});
+		}
+	}
+
+	const ButtonBinding& binding = Tables->Buttons[button];
+
+	if(pressed && !previouslypressed && binding.MappedAction != UnmappedBinding)
+	{
+		mapped.SetAction(static_cast<Action>(binding.MappedAction));
+		return;
+	}
+
+	if(pressed && binding.MappedState != UnmappedBinding)
+	{
+		mapped.SetState(static_cast<State>(binding.MappedState));
+		return;
+	}
+
+	// Eat any input mapped to the button
+	if(binding.MappedAction != UnmappedBinding)
+		mapped.EatAction(static_cast<Action>(binding.MappedAction));
+
+	if(binding.MappedState != UnmappedBinding)
+		mapped.EatState(static_cast<State>(binding.MappedState));
+}
+
+
+//
+// Claim every raw input this context binds in a resolved table
+//
+// The given depth is this context's position in the stack; any owner
+// already recorded for an input this context binds is shadowed.
+//
+void InputContext::OverlayBindings(ResolvedBindings& bindings, unsigned short depth) const
+{
+	for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+	{
+		if(BoundButtons & (1u << i))
+			bindings.ButtonOwners[i] = depth;
+	}
+
+	for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+	{
+		if(Tables->Axes[i] != UnmappedBinding)
+			bindings.AxisOwners[i] = depth;
+	}
+}
+
+
+//
+// Helper: build runtime filter chains from their table descriptions
+//
+// This is the only per-context work done beyond pointing at the tables;
+// it is needed so response curves get their lookup tables.
+//
+void InputContext::BuildFilterChains()
+{
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
+	{
+		if(Tables->FilterStageCounts[i] > AnalogFilterState::MaxStages)
+			throw std::runtime_error("Too many filter stages specified for a single range");
+
+		for(unsigned j = 0; j < Tables->FilterStageCounts[i]; ++j)
+		{
+			const FilterStageDescription& stage = Tables->FilterStages[i][j];
+			if(stage.Type >= ANALOG_FILTER_TYPE_COUNT)
+				throw std::runtime_error("Invalid filter type specified");
+
+			FilterTable[i].AddStage(static_cast<AnalogFilterType>(stage.Type), stage.Parameter);
+		}
+
+		if(Tables->FilterStageCounts[i])
+			++FilteredRangeCount;
+	}
+}
+
+//
+// Helper: note which raw buttons this context binds, plainly, with modifiers, or in combos
+//
+void InputContext::FindBoundButtons()
+{
+	BoundButtons = Combos.GetButtons();
+	for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+	{
+		RawInputButton button = static_cast<RawInputButton>(i);
+		if(Tables->Buttons[i].MappedAction != UnmappedBinding || Tables->Buttons[i].MappedState != UnmappedBinding || ModifierBindings.HasBindings(button))
+			BoundButtons |= 1u << i;
+	}
 }
 
+//
+// Helper: make sure every ID in a set of compiled tables fits the dense tables used at runtime
+//
+void InputContext::ValidateTables() const
+{
+	for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+	{
+		const ButtonBinding& binding = Tables->Buttons[i];
+		if((binding.MappedAction != UnmappedBinding && binding.MappedAction >= ACTION_COUNT) || (binding.MappedState != UnmappedBinding && binding.MappedState >= STATE_COUNT))
+			throw std::runtime_error("Out of range input ID in compiled context");
+	}
+
+	for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+	{
+		if(Tables->Axes[i] != UnmappedBinding && Tables->Axes[i] >= RANGE_COUNT)
+			throw std::runtime_error("Out of range input ID in compiled context");
+	}
+}
@@ -13,7 +13,15 @@
 #include "RawInputConstants.h"
 #include "InputConstants.h"
 #include "RangeConverter.h"
-#include <map>
+#include "InputBindings.h"
+#include "MappedInput.h"
+#include "AnalogFilter.h"
+#include "ContextTables.h"
+#include "ComboRecognizer.h"
+#include "ModifierBindings.h"
+#include "InputIdentifiers.h"
+
+#include <string>
 
 
 namespace InputMapping
@@ -23,7 +31,8 @@ namespace InputMapping
 	{
 	// Construction and destruction
 	public:
-		explicit InputContext(const std::wstring& contextfilename);
+		InputContext(const std::wstring& contextfilename, const InputIdentifierTable& identifiers);
+		explicit InputContext(const ContextTables& compiledtables);
 		~InputContext();
 
 	// Mapping interface
@@ -33,18 +42,53 @@ namespace InputMapping
 		bool MapAxisToRange(RawInputAxis axis, Range& out) const;
 
 		double GetSensitivity(Range range) const;
-		
+
+		void MapButton(MappedInput& mapped, RawInputButton button, bool pressed, bool previouslypressed, unsigned heldbuttons) const;
+
+		void OverlayBindings(ResolvedBindings& bindings, unsigned short depth) const;
+
 		const RangeConverter& GetConversions() const
-		{ return *Conversions; }
+		{ return Conversions; }
+
+		const AnalogFilterChain& GetFilters(Range range) const
+		{ return FilterTable[range]; }
+
+		bool HasFilterChains() const
+		{ return FilteredRangeCount != 0; }
+
+		const ComboRecognizer& GetCombos() const
+		{ return Combos; }
+
+		const ModifierBindingTable& GetModifierBindings() const
+		{ return ModifierBindings; }
+
+	// Compilation interface
+	public:
+		const ContextTables& GetTables() const
+		{ return *Tables; }
+
+	// Internal helpers
+	private:
+		void BuildFilterChains();
+		void FindBoundButtons();
+		void ValidateTables() const;
 
 	// Internal tracking
 	private:
-		std::map<RawInputButton, Action> ActionMap;
-		std::map<RawInputButton, State> StateMap;
-		std::map<RawInputAxis, Range> RangeMap;
+		// Bindings are stored in flat tables indexed directly by raw
+		// input/range ID, so each lookup is a single load. The tables
+		// are owned when loaded from text, and borrowed from a mapped
+		// image when loaded from a compiled context file.
+		ContextTables* OwnedTables;
+		const ContextTables* Tables;
+
+		RangeConverter Conversions;
+		AnalogFilterChain FilterTable[RANGE_COUNT];
+		ComboRecognizer Combos;
+		ModifierBindingTable ModifierBindings;
 
-		std::map<Range, double> SensitivityMap;
-		RangeConverter* Conversions;
+		unsigned BoundButtons;		// One bit per raw button bound in any way
+		unsigned FilteredRangeCount;
 	};
 
 }
@@ -0,0 +1,110 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Non-allocating type-erased wrapper for input callbacks
+//
+
+#pragma once
+
+
+// Dependencies
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+
+namespace InputMapping
+{
+
+	// Forward declarations
+	struct MappedInput;
+
+
+	//
+	// Type-erased input callback with inline storage
+	//
+	// A delegate can wrap a plain function, an object and one of its member
+	// functions, or any small function object (such as a lambda capturing a
+	// pointer or two). The callable is stored inside the delegate itself, so
+	// unlike std::function, creating or copying a delegate never allocates,
+	// and invoking one costs a single indirect call.
+	//
+	// To keep copies trivial, stored function objects must be trivially
+	// copyable and destructible and fit within StorageSize bytes; this is
+	// checked at compile time.
+	//
+	class InputDelegate
+	{
+	// Constants
+	public:
+		static const size_t StorageSize = 3 * sizeof(void*);
+
+	// Construction
+	public:
+		InputDelegate()
+			: Invoker(NULL)
+		{
+		}
+
+		InputDelegate(void (*function)(MappedInput&))
+			: Invoker(&InvokeFunctor<FunctionPointer>)
+		{
+			new (Storage.Bytes) FunctionPointer(function);
+		}
+
+		template <typename FunctorType>
+		InputDelegate(const FunctorType& functor)
+			: Invoker(&InvokeFunctor<FunctorType>)
+		{
+			static_assert(sizeof(FunctorType) <= StorageSize, "Callable is too large to store in an InputDelegate");
+			static_assert(std::is_trivially_copyable<FunctorType>::value && std::is_trivially_destructible<FunctorType>::value, "Callables stored in an InputDelegate must be trivially copyable");
+
+			new (Storage.Bytes) FunctorType(functor);
+		}
+
+		template <typename ObjectType, void (ObjectType::*Method)(MappedInput&)>
+		static InputDelegate FromMethod(ObjectType* object)
+		{
+			InputDelegate ret;
+			ret.Invoker = &InvokeMethod<ObjectType, Method>;
+			new (ret.Storage.Bytes) ObjectType*(object);
+			return ret;
+		}
+
+	// Invocation interface
+	public:
+		void operator () (MappedInput& input) const
+		{ Invoker(Storage.Bytes, input); }
+
+		bool IsBound() const
+		{ return Invoker != NULL; }
+
+	// Internal helpers
+	private:
+		typedef void (*InvokerFunc)(const void* storage, MappedInput& input);
+		typedef void (*FunctionPointer)(MappedInput& input);
+
+		template <typename FunctorType>
+		static void InvokeFunctor(const void* storage, MappedInput& input)
+		{ (*static_cast<const FunctorType*>(storage))(input); }
+
+		template <typename ObjectType, void (ObjectType::*Method)(MappedInput&)>
+		static void InvokeMethod(const void* storage, MappedInput& input)
+		{ ((*static_cast<ObjectType* const*>(storage))->*Method)(input); }
+
+	// Internal tracking
+	private:
+		union
+		{
+			unsigned char Bytes[StorageSize];
+			void* AlignAsPointer;
+			double AlignAsDouble;
+		} Storage;
+
+		InvokerFunc Invoker;
+	};
+
+}
+
@@ -0,0 +1,326 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Interning of action, state, and range names into dense IDs
+//
+
+#include "pch.h"
+
+#include "InputIdentifiers.h"
+#include "FileIO.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+using namespace InputMapping;
+
+
+//
+// Internal helpers
+//
+namespace
+{
+	//
+	// Names of the built-in identifiers, in ID order
+	//
+	const wchar_t* BuiltinActionNames[ACTION_BUILTIN_COUNT] =
+	{
+		L"ACTION_ONE", L"ACTION_TWO", L"ACTION_THREE", L"ACTION_FOUR", L"ACTION_FIVE", L"ACTION_SIX", L"ACTION_SEVEN",
+	};
+
+	const wchar_t* BuiltinStateNames[STATE_BUILTIN_COUNT] =
+	{
+		L"STATE_ONE", L"STATE_TWO", L"STATE_THREE",
+	};
+
+	const wchar_t* BuiltinRangeNames[RANGE_BUILTIN_COUNT] =
+	{
+		L"RANGE_ONE", L"RANGE_TWO",
+	};
+
+	const unsigned MaximumIdentifierCounts[INPUT_IDENTIFIER_KIND_COUNT] = { ACTION_COUNT, STATE_COUNT, RANGE_COUNT };
+
+	// Average number of keys per hash bucket; smaller buckets are quicker
+	// to place, at the cost of one displacement entry per bucket
+	const unsigned KeysPerBucket = 2;
+
+	// Seeds to try for a single bucket before giving up on the table
+	const unsigned MaximumDisplacementAttempts = 1 << 20;
+
+	//
+	// Helper for ordering identifier keys when checking for duplicates
+	//
+	struct KeyLess
+	{
+		const std::vector<std::wstring>* Names;
+
+		bool operator () (const std::pair<unsigned, unsigned>& lhs, const std::pair<unsigned, unsigned>& rhs) const
+		{
+			if(lhs.first != rhs.first)
+				return lhs.first < rhs.first;
+
+			return Names[lhs.first][lhs.second] < Names[rhs.first][rhs.second];
+		}
+	};
+}
+
+
+//
+// Construct a table holding just the built-in identifiers
+//
+InputIdentifierTable::InputIdentifierTable()
+{
+	for(unsigned i = 0; i < ACTION_BUILTIN_COUNT; ++i)
+		Names[INPUT_IDENTIFIER_ACTION].push_back(BuiltinActionNames[i]);
+
+	for(unsigned i = 0; i < STATE_BUILTIN_COUNT; ++i)
+		Names[INPUT_IDENTIFIER_STATE].push_back(BuiltinStateNames[i]);
+
+	for(unsigned i = 0; i < RANGE_BUILTIN_COUNT; ++i)
+		Names[INPUT_IDENTIFIER_RANGE].push_back(BuiltinRangeNames[i]);
+
+	Build();
+}
+
+
+//
+// Declare a new identifier, returning the ID it is assigned
+//
+// Lookups do not see the new identifier until Build() is called; this way
+// any number of identifiers can be declared for the cost of a single build.
+//
+unsigned InputIdentifierTable::Declare(InputIdentifierKind kind, const std::wstring& name)
+{
+	if(Names[kind].size() >= MaximumIdentifierCounts[kind])
+		throw std::runtime_error("Too many input identifiers declared; raise the INPUTMAPPING_MAX_* limits");
+
+	if(name.empty() || (name[0] >= L'0' && name[0] <= L'9'))
+		throw std::runtime_error("Input identifier names must not be empty or begin with a digit");
+
+	Names[kind].push_back(name);
+	return static_cast<unsigned>(Names[kind].size() - 1);
+}
+
+//
+// Lay out the perfect hash over every declared identifier
+//
+void InputIdentifierTable::Build()
+{
+	std::vector<std::pair<unsigned, unsigned> > keys;
+	for(unsigned kind = 0; kind < INPUT_IDENTIFIER_KIND_COUNT; ++kind)
+	{
+		for(unsigned id = 0; id < Names[kind].size(); ++id)
+			keys.push_back(std::make_pair(kind, id));
+	}
+
+	// Duplicate keys could never be sent to distinct slots, so catch them up front
+	KeyLess less = { Names };
+	std::vector<std::pair<unsigned, unsigned> > sorted(keys);
+	std::sort(sorted.begin(), sorted.end(), less);
+	for(size_t i = 1; i < sorted.size(); ++i)
+	{
+		if(!less(sorted[i - 1], sorted[i]))
+			throw std::runtime_error("Input identifier declared more than once");
+	}
+
+	// Slot count is a power of two so that the final hash can be masked
+	size_t slotcount = 1;
+	while(slotcount < keys.size())
+		slotcount <<= 1;
+
+	size_t bucketcount = (keys.size() + KeysPerBucket - 1) / KeysPerBucket;
+	if(bucketcount == 0)
+		bucketcount = 1;
+
+	std::vector<std::vector<size_t> > buckets(bucketcount);
+	for(size_t i = 0; i < keys.size(); ++i)
+	{
+		const std::wstring& name = Names[keys[i].first][keys[i].second];
+		buckets[Hash(keys[i].first, name.begin(), name.end(), 0) % bucketcount].push_back(i);
+	}
+
+	// Place the largest buckets first, while the table is still mostly empty
+	std::vector<size_t> order(bucketcount);
+	for(size_t i = 0; i < bucketcount; ++i)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return buckets[lhs].size() > buckets[rhs].size(); });
+
+	Slot empty = { INPUT_IDENTIFIER_KIND_COUNT, 0 };
+	Slots.assign(slotcount, empty);
+	Displacements.assign(bucketcount, 0);
+
+	std::vector<size_t> candidates;
+	for(size_t i = 0; i < bucketcount && !buckets[order[i]].empty(); ++i)
+	{
+		const std::vector<size_t>& bucket = buckets[order[i]];
+
+		unsigned seed = 1;
+		for(; seed <= MaximumDisplacementAttempts; ++seed)
+		{
+			candidates.clear();
+			for(size_t j = 0; j < bucket.size(); ++j)
+			{
+				const std::wstring& name = Names[keys[bucket[j]].first][keys[bucket[j]].second];
+				size_t slot = Hash(keys[bucket[j]].first, name.begin(), name.end(), seed) & (slotcount - 1);
+				if(Slots[slot].Kind != INPUT_IDENTIFIER_KIND_COUNT || std::find(candidates.begin(), candidates.end(), slot) != candidates.end())
+					break;
+
+				candidates.push_back(slot);
+			}
+
+			if(candidates.size() == bucket.size())
+				break;
+		}
+
+		if(seed > MaximumDisplacementAttempts)
+			throw std::runtime_error("Failed to build input identifier hash table");
+
+		Displacements[order[i]] = seed;
+		for(size_t j = 0; j < bucket.size(); ++j)
+		{
+			Slots[candidates[j]].Kind = keys[bucket[j]].first;
+			Slots[candidates[j]].ID = keys[bucket[j]].second;
+		}
+	}
+}
+
+
+//
+// Determine whether two tables declare the same identifiers with the same IDs
+//
+bool InputIdentifierTable::operator == (const InputIdentifierTable& other) const
+{
+	for(unsigned kind = 0; kind < INPUT_IDENTIFIER_KIND_COUNT; ++kind)
+	{
+		if(Names[kind] != other.Names[kind])
+			return false;
+	}
+
+	return true;
+}
+
+
+//
+// Look up an identifier given its name as a range of narrow characters
+//
+bool InputIdentifierTable::Find(InputIdentifierKind kind, const char* begin, const char* end, unsigned& out) const
+{
+	return FindHelper(kind, begin, end, out);
+}
+
+//
+// Look up an identifier given its name
+//
+bool InputIdentifierTable::Find(InputIdentifierKind kind, const std::wstring& name, unsigned& out) const
+{
+	return FindHelper(kind, name.begin(), name.end(), out);
+}
+
+//
+// Typed lookup helpers
+//
+bool InputIdentifierTable::FindAction(const std::wstring& name, Action& out) const
+{
+	unsigned id;
+	if(!Find(INPUT_IDENTIFIER_ACTION, name, id))
+		return false;
+
+	out = static_cast<Action>(id);
+	return true;
+}
+
+bool InputIdentifierTable::FindState(const std::wstring& name, State& out) const
+{
+	unsigned id;
+	if(!Find(INPUT_IDENTIFIER_STATE, name, id))
+		return false;
+
+	out = static_cast<State>(id);
+	return true;
+}
+
+bool InputIdentifierTable::FindRange(const std::wstring& name, Range& out) const
+{
+	unsigned id;
+	if(!Find(INPUT_IDENTIFIER_RANGE, name, id))
+		return false;
+
+	out = static_cast<Range>(id);
+	return true;
+}
+
+
+//
+// Helper: hash an identifier's kind and name under a given seed
+//
+// Characters are hashed as code units, so narrow and wide spellings of
+// the same plain ASCII name hash identically.
+//
+template <typename CharIter>
+unsigned InputIdentifierTable::Hash(unsigned kind, CharIter begin, CharIter end, unsigned seed)
+{
+	unsigned hash = 2166136261u ^ (seed * 0x9e3779b9u);
+	hash = (hash ^ kind) * 16777619u;
+	for(CharIter iter = begin; iter != end; ++iter)
+		hash = (hash ^ static_cast<unsigned>(*iter)) * 16777619u;
+
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+//
+// Helper: find the one slot a name can occupy, and check whether it is really there
+//
+template <typename CharIter>
+bool InputIdentifierTable::FindHelper(InputIdentifierKind kind, CharIter begin, CharIter end, unsigned& out) const
+{
+	unsigned seed = Displacements[Hash(kind, begin, end, 0) % Displacements.size()];
+	if(seed == 0)
+		return false;
+
+	const Slot& slot = Slots[Hash(kind, begin, end, seed) & (Slots.size() - 1)];
+	if(slot.Kind != static_cast<unsigned>(kind))
+		return false;
+
+	const std::wstring& name = Names[kind][slot.ID];
+	if(name.size() != static_cast<size_t>(end - begin) || !std::equal(begin, end, name.begin()))
+		return false;
+
+	out = slot.ID;
+	return true;
+}
+
+
+//
+// Read an action, state, or range from a context file, by name or by ID
+//
+unsigned InputMapping::ReadInputIdentifier(TextFileReader& infile, const InputIdentifierTable& identifiers, InputIdentifierKind kind)
+{
+	const char* begin;
+	const char* end;
+	if(!infile.ReadToken(begin, end))
+		throw std::runtime_error("Failed to read a required value");
+
+	unsigned id;
+	if(ParseToken(begin, end, id))
+	{
+		if(id >= identifiers.GetCount(kind))
+			throw std::runtime_error("Out of range input ID in context file");
+
+		return id;
+	}
+
+	if(!identifiers.Find(kind, begin, end, id))
+		throw std::runtime_error("Unknown input identifier name in context file");
+
+	return id;
+}
+
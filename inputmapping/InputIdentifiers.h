@@ -0,0 +1,117 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Interning of action, state, and range names into dense IDs
+//
+
+#pragma once
+
+
+// Dependencies
+#include "InputConstants.h"
+
+#include <string>
+#include <vector>
+
+
+// Forward declarations
+class TextFileReader;
+
+
+namespace InputMapping
+{
+
+	//
+	// Kinds of identifier which can be declared by name
+	//
+	enum InputIdentifierKind
+	{
+		INPUT_IDENTIFIER_ACTION,
+		INPUT_IDENTIFIER_STATE,
+		INPUT_IDENTIFIER_RANGE,
+
+		INPUT_IDENTIFIER_KIND_COUNT
+	};
+
+
+	//
+	// Table of every action, state, and range known by name
+	//
+	// The built-in identifiers from InputConstants.h are always present,
+	// under the same names as their enumerators; further identifiers can
+	// be declared in data, and receive the next free IDs of their kind in
+	// declaration order. IDs stay dense, so everything downstream remains
+	// indexed directly by ID.
+	//
+	// Once all identifiers are declared, Build() lays out a perfect hash
+	// over them (hash-and-displace: each key hashes to a bucket, and each
+	// bucket stores the seed that sends its keys to free slots). Any name
+	// can then be found with two hashes and a single comparison, and no
+	// probing or chaining is ever needed. The hash is not minimal: the slot
+	// count is rounded up to a power of two so the final hash can be masked,
+	// which leaves up to half of the slots empty.
+	//
+	class InputIdentifierTable
+	{
+	// Construction
+	public:
+		InputIdentifierTable();
+
+	// Declaration interface
+	public:
+		unsigned Declare(InputIdentifierKind kind, const std::wstring& name);
+		void Build();
+
+		unsigned GetCount(InputIdentifierKind kind) const
+		{ return static_cast<unsigned>(Names[kind].size()); }
+
+		const std::wstring& GetName(InputIdentifierKind kind, unsigned id) const
+		{ return Names[kind][id]; }
+
+		bool operator == (const InputIdentifierTable& other) const;
+		bool operator != (const InputIdentifierTable& other) const
+		{ return !(*this == other); }
+
+	// Lookup interface
+	public:
+		bool Find(InputIdentifierKind kind, const char* begin, const char* end, unsigned& out) const;
+		bool Find(InputIdentifierKind kind, const std::wstring& name, unsigned& out) const;
+
+		bool FindAction(const std::wstring& name, Action& out) const;
+		bool FindState(const std::wstring& name, State& out) const;
+		bool FindRange(const std::wstring& name, Range& out) const;
+
+	// Internal helpers
+	private:
+		struct Slot
+		{
+			unsigned Kind;
+			unsigned ID;
+		};
+
+		template <typename CharIter>
+		static unsigned Hash(unsigned kind, CharIter begin, CharIter end, unsigned seed);
+
+		template <typename CharIter>
+		bool FindHelper(InputIdentifierKind kind, CharIter begin, CharIter end, unsigned& out) const;
+
+	// Internal tracking
+	private:
+		std::vector<std::wstring> Names[INPUT_IDENTIFIER_KIND_COUNT];
+
+		std::vector<unsigned> Displacements;
+		std::vector<Slot> Slots;
+	};
+
+
+	//
+	// Helper for reading an action, state, or range from a context file
+	//
+	// Identifiers may be given either by name or by numeric ID.
+	//
+	unsigned ReadInputIdentifier(TextFileReader& infile, const InputIdentifierTable& identifiers, InputIdentifierKind kind);
+
+}
+
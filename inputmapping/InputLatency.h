@@ -0,0 +1,179 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Lock-free histograms for measuring input latency
+//
+
+#pragma once
+
+
+// Dependencies
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <atomic>
+#include <cmath>
+
+
+namespace InputMapping
+{
+
+	//
+	// Histogram of durations in nanoseconds, written by one thread and
+	// readable from any number of others
+	//
+	// Buckets are log-linear: each power of two is split into eight equal
+	// buckets, so any recorded value is known to within 12.5% while the
+	// whole range of a 64-bit value fits in under 500 counters. Recording a
+	// value is a bit scan and a couple of relaxed stores; readers never block
+	// the writer, and may see a sample counted in its bucket slightly before
+	// or after it shows up in the totals.
+	//
+	// Histograms are cumulative. To look at a particular stretch of time,
+	// copy the bucket counts at its start and subtract them at the end.
+	//
+	class LatencyHistogram
+	{
+	// Constants
+	public:
+		static const unsigned SubBucketBits = 3;
+		static const unsigned SubBucketCount = 1 << SubBucketBits;
+		static const unsigned BucketCount = SubBucketCount * (64 - SubBucketBits + 1);
+
+	// Construction
+	public:
+		LatencyHistogram()
+			: Count(0),
+			  Total(0),
+			  Maximum(0)
+		{
+			for(unsigned i = 0; i < BucketCount; ++i)
+				Buckets[i].store(0, std::memory_order_relaxed);
+		}
+
+	// Writer interface
+	public:
+		//
+		// Count one sample; only one thread may ever call this
+		//
+		void Record(unsigned long long nanoseconds)
+		{
+			std::atomic<unsigned long long>& bucket = Buckets[GetBucketIndex(nanoseconds)];
+			bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+			Count.store(Count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			Total.store(Total.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+			if(nanoseconds > Maximum.load(std::memory_order_relaxed))
+				Maximum.store(nanoseconds, std::memory_order_relaxed);
+		}
+
+	// Reader interface
+	public:
+		unsigned long long GetCount() const
+		{ return Count.load(std::memory_order_relaxed); }
+
+		unsigned long long GetMaximum() const
+		{ return Maximum.load(std::memory_order_relaxed); }
+
+		double GetMean() const
+		{
+			unsigned long long count = Count.load(std::memory_order_relaxed);
+			return count ? static_cast<double>(Total.load(std::memory_order_relaxed)) / count : 0.0;
+		}
+
+		unsigned long long GetBucketSamples(unsigned bucket) const
+		{ return Buckets[bucket].load(std::memory_order_relaxed); }
+
+		//
+		// Largest value which lands in a given bucket
+		//
+		static unsigned long long GetBucketUpperBound(unsigned bucket)
+		{
+			if(bucket < SubBucketCount)
+				return bucket;
+
+			unsigned shift = bucket / SubBucketCount - 1;
+			unsigned long long lower = static_cast<unsigned long long>(SubBucketCount + bucket % SubBucketCount) << shift;
+			return lower + ((1ull << shift) - 1);
+		}
+
+		//
+		// Value below which the given fraction of samples fall, e.g. 0.99
+		// for the 99th percentile; accurate to the width of a bucket
+		//
+		unsigned long long GetPercentile(double fraction) const
+		{
+			unsigned long long counts[BucketCount];
+			unsigned long long total = 0;
+			for(unsigned i = 0; i < BucketCount; ++i)
+			{
+				counts[i] = Buckets[i].load(std::memory_order_relaxed);
+				total += counts[i];
+			}
+
+			if(!total)
+				return 0;
+
+			unsigned long long target = static_cast<unsigned long long>(std::ceil(fraction * total));
+			if(target < 1)
+				target = 1;
+
+			unsigned long long seen = 0;
+			for(unsigned i = 0; i < BucketCount; ++i)
+			{
+				seen += counts[i];
+				if(seen >= target)
+				{
+					unsigned long long bound = GetBucketUpperBound(i);
+					unsigned long long maximum = GetMaximum();
+					return (maximum && maximum < bound) ? maximum : bound;
+				}
+			}
+
+			return GetMaximum();
+		}
+
+	// Internal helpers
+	private:
+		static unsigned GetBucketIndex(unsigned long long value)
+		{
+			if(value < SubBucketCount)
+				return static_cast<unsigned>(value);
+
+			unsigned shift = HighestBit(value) - SubBucketBits;
+			return (shift + 1) * SubBucketCount + static_cast<unsigned>((value >> shift) - SubBucketCount);
+		}
+
+		static unsigned HighestBit(unsigned long long bits)
+		{
+#if defined(_MSC_VER) && defined(_M_IX86)
+			// 32-bit builds only have the 32-bit scan, so take each half in turn
+			unsigned long index;
+			if(_BitScanReverse(&index, static_cast<unsigned long>(bits >> 32)))
+				return index + 32;
+
+			_BitScanReverse(&index, static_cast<unsigned long>(bits));
+			return index;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse64(&index, bits);
+			return index;
+#else
+			return 63 - static_cast<unsigned>(__builtin_clzll(bits));
+#endif
+		}
+
+	// Internal tracking
+	private:
+		std::atomic<unsigned long long> Buckets[BucketCount];
+
+		std::atomic<unsigned long long> Count;
+		std::atomic<unsigned long long> Total;
+		std::atomic<unsigned long long> Maximum;
+	};
+
+}
+
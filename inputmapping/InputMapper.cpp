@@ -10,30 +10,102 @@
 
 #include "InputMapper.h"
 #include "InputContext.h"
+#include "ContextSet.h"
+#include "ContextLibrary.h"
+#include "InputRecording.h"
 
-#include "FileIO.h"
-
-#include <fstream>
+#include <algorithm>
 
 
 using namespace InputMapping;
 
 
 //
-// Construct and initialize an input mapper
+// Constants
+//
+namespace
+{
+	// Number of raw events that may be queued between two ticks
+	// before the producer starts seeing failed pushes
+	const size_t RawInputQueueCapacity = 4096;
+}
+
+
+//
+// Construct and initialize an input mapper from the text context files
 //
 InputMapper::InputMapper()
+	: ButtonPresses(0),
+	  PublishedContexts(NULL),
+	  ContextSourceFile(L"ContextList.txt"),
+	  ContextSourceIsCompiled(false),
+	  WatchStopRequested(false),
+	  Dispatching(false),
+	  DeferredCallbackRemovals(0),
+	  CurrentMappedInput(),
+	  HeldButtons(0),
+	  PendingRawInput(RawInputQueueCapacity),
+	  Recording(NULL),
+	  LatencyTracking(false)
 {
-	unsigned count;
-	std::wifstream infile(L"ContextList.txt");
-	if(!(infile >> count))
-		throw std::exception("Failed to read ContextList.txt");
-	for(unsigned i = 0; i < count; ++i)
-	{
-		std::wstring name = AttemptRead<std::wstring>(infile);
-		std::wstring file = AttemptRead<std::wstring>(infile);
-		InputContexts[name] = new InputContext(file);
-	}
+	Initialize();
+
+	LatestContexts = ContextSet::LoadText(ContextSourceFile, NULL);
+	Contexts = LatestContexts;
+	BindContextHandles();
+}
+
+//
+// Construct and initialize an input mapper from a compiled context image
+//
+// The image is mapped into memory and its tables are used in place, so
+// no parsing is done at all; see ContextCompiler for producing images.
+//
+InputMapper::InputMapper(const std::wstring& compiledimagefile)
+	: ButtonPresses(0),
+	  PublishedContexts(NULL),
+	  ContextSourceFile(compiledimagefile),
+	  ContextSourceIsCompiled(true),
+	  WatchStopRequested(false),
+	  Dispatching(false),
+	  DeferredCallbackRemovals(0),
+	  CurrentMappedInput(),
+	  HeldButtons(0),
+	  PendingRawInput(RawInputQueueCapacity),
+	  Recording(NULL),
+	  LatencyTracking(false)
+{
+	Initialize();
+
+	LatestContexts = ContextSet::LoadCompiled(ContextSourceFile, NULL);
+	Contexts = LatestContexts;
+	BindContextHandles();
+}
+
+//
+// Construct and initialize an input mapper sharing the contexts of a library
+//
+// No files are loaded, and the contexts are never reloaded; the mapper
+// keeps them alive for as long as it exists.
+//
+InputMapper::InputMapper(const ContextLibrary& library)
+	: ButtonPresses(0),
+	  PublishedContexts(NULL),
+	  ContextSourceIsCompiled(false),
+	  WatchStopRequested(false),
+	  Dispatching(false),
+	  DeferredCallbackRemovals(0),
+	  CurrentMappedInput(),
+	  HeldButtons(0),
+	  PendingRawInput(RawInputQueueCapacity),
+	  Recording(NULL),
+	  LatencyTracking(false)
+{
+	Initialize();
+
+	LatestContexts = library.GetContexts();
+	Contexts = LatestContexts;
+	BindContextHandles();
 }
 
 //
@@ -41,8 +113,8 @@ InputMapper::InputMapper()
 //
 InputMapper::~InputMapper()
 {
-	for(std::map<std::wstring, InputContext*>::iterator iter = InputContexts.begin(); iter != InputContexts.end(); ++iter)
-		delete iter->second;
+	StopWatchingContextFiles();
+	delete PublishedContexts.exchange(NULL);
 }
 
 
@@ -51,11 +123,26 @@ InputMapper::~InputMapper()
 //
 void InputMapper::Clear()
 {
-	CurrentMappedInput.Actions.clear();
-	CurrentMappedInput.Ranges.clear();
+	if(Recording)
+		Recording->RecordClear(GetInputTimestamp());
+
+	CurrentMappedInput.Actions.reset();
+	CurrentMappedInput.Ranges.reset();
+
+	for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+	{
+		AxisAccumulators[i].Total = 0.0;
+		AxisAccumulators[i].SampleCount = 0;
+		AxisAccumulators[i].HistoryCount = 0;
+	}
+
 	// Note: we do NOT clear states, because they need to remain set
 	// across frames so that they don't accidentally show "off" for
 	// a tick or two while the raw input is still pending.
+
+	// The end of a tick is the one point where nothing staged refers
+	// into the current contexts, so reloaded contexts are swapped in here
+	AdoptPublishedContexts();
 }
 
 //
@@ -63,28 +150,55 @@ void InputMapper::Clear()
 //
 void InputMapper::SetRawButtonState(RawInputButton button, bool pressed, bool previouslypressed)
 {
-	Action action;
-	State state;
+	InputTimestamp timestamp = (Recording || LatencyTracking || (pressed && !previouslypressed)) ? GetInputTimestamp() : 0;
+	MapRawButtonState(button, pressed, previouslypressed, timestamp);
+}
 
-	if(pressed && !previouslypressed)
-	{
-		if(MapButtonToAction(button, action))
-		{
-			CurrentMappedInput.Actions.insert(action);
-			return;
-		}
-	}
+//
+// Helper: map a raw button state change through the context which owns the button
+//
+// The topmost context binding the button in any way, which the resolved
+// table finds with a single lookup, sees the press. Its combos are fed the
+// press first, and a completed combo's action is mapped in addition to
+// whatever the button itself maps to.
+//
+void InputMapper::MapRawButtonState(RawInputButton button, bool pressed, bool previouslypressed, InputTimestamp timestamp)
+{
+	unsigned short owner = ResolvedStack.Back().ButtonOwners[button];
+
+	if(Recording)
+		Recording->RecordButton(timestamp, button, pressed, previouslypressed);
+
+	if(LatencyTracking)
+		PendingEventTimestamps.push_back(timestamp);
 
 	if(pressed)
+		HeldButtons |= (1u << button);
+	else
+		HeldButtons &= ~(1u << button);
+
+	if(pressed && !previouslypressed)
+		++ButtonPresses;
+
+	if(owner == NoBindingOwner)
+		return;
+
+	const InputContext* context = ContextsByHandle[ActiveContexts[owner]];
+	const ComboRecognizer& combos = context->GetCombos();
+	if(pressed && !previouslypressed && !combos.IsEmpty())
 	{
-		if(MapButtonToState(button, state))
-		{
-			CurrentMappedInput.States.insert(state);
-			return;
-		}
+		ComboProgress& progress = ComboStates[owner];
+		unsigned long long* active = ComboActiveSteps.data() + progress.ActiveOffset;
+
+		// Any press which went elsewhere since this context's last one has broken its combos
+		if(progress.LastPress + 1 != ButtonPresses)
+			std::fill(active, active + combos.GetWordCount(), 0ull);
+
+		combos.Press(active, ComboStepTimes.data() + progress.StepTimesOffset, button, HeldButtons, timestamp, [this](Action action) { CurrentMappedInput.SetAction(action); });
+		progress.LastPress = ButtonPresses;
 	}
 
-	MapAndEatButton(button);
+	context->MapButton(CurrentMappedInput, button, pressed, previouslypressed, HeldButtons);
 }
 
 //
@@ -92,49 +206,358 @@ void InputMapper::SetRawButtonState(RawInputButton button, bool pressed, bool pr
 //
 void InputMapper::SetRawAxisValue(RawInputAxis axis, double value)
 {
-	for(std::list<InputContext*>::const_iterator iter = ActiveContexts.begin(); iter != ActiveContexts.end(); ++iter)
+	InputTimestamp timestamp = (Recording || LatencyTracking || !AxisAccumulators[axis].History.empty()) ? GetInputTimestamp() : 0;
+	MapRawAxisValue(axis, value, timestamp);
+}
+
+
+//
+// Choose how multiple samples of a raw axis within a single tick are combined
+//
+void InputMapper::SetRawAxisMode(RawInputAxis axis, RawAxisMode mode)
+{
+	if(Recording)
+		Recording->RecordAxisMode(GetInputTimestamp(), axis, mode);
+
+	AxisAccumulators[axis].Mode = mode;
+}
+
+//
+// Keep up to the given number of timestamped samples per tick for a raw axis
+//
+// Once the capacity is exceeded the oldest samples are overwritten. Passing
+// a capacity of zero turns the history off again.
+//
+void InputMapper::EnableRawAxisSampleHistory(RawInputAxis axis, size_t capacity)
+{
+	if(Recording)
+		Recording->RecordAxisHistory(GetInputTimestamp(), axis, capacity);
+
+	AxisAccumulators[axis].History.resize(capacity);
+	AxisAccumulators[axis].HistoryCount = 0;
+}
+
+//
+// Retrieve the number of samples retained for a raw axis this tick
+//
+size_t InputMapper::GetRawAxisSampleCount(RawInputAxis axis) const
+{
+	const RawAxisAccumulator& accumulator = AxisAccumulators[axis];
+	if(accumulator.HistoryCount > accumulator.History.size())
+		return accumulator.History.size();
+
+	return accumulator.HistoryCount;
+}
+
+//
+// Retrieve a retained sample for a raw axis, oldest first
+//
+const RawAxisSample& InputMapper::GetRawAxisSample(RawInputAxis axis, size_t index) const
+{
+	const RawAxisAccumulator& accumulator = AxisAccumulators[axis];
+	size_t first = accumulator.HistoryCount - GetRawAxisSampleCount(axis);
+	return accumulator.History[(first + index) % accumulator.History.size()];
+}
+
+
+//
+// Queue a raw button state change for processing on the next tick
+//
+// Returns false if the queue is full, in which case the event is dropped.
+//
+bool InputMapper::QueueRawButtonState(RawInputButton button, bool pressed, bool previouslypressed, InputTimestamp timestamp)
+{
+	RawInputEvent event;
+	event.Type = RawInputEvent::EVENT_BUTTON;
+	event.Timestamp = timestamp;
+	event.Button = button;
+	event.Pressed = pressed;
+	event.PreviouslyPressed = previouslypressed;
+	event.Axis = RAW_INPUT_AXIS_MOUSE_X;
+	event.Value = 0.0;
+
+	return PendingRawInput.Push(event);
+}
+
+//
+// Queue a raw axis value for processing on the next tick
+//
+// Returns false if the queue is full, in which case the event is dropped.
+//
+bool InputMapper::QueueRawAxisValue(RawInputAxis axis, double value, InputTimestamp timestamp)
+{
+	RawInputEvent event;
+	event.Type = RawInputEvent::EVENT_AXIS;
+	event.Timestamp = timestamp;
+	event.Button = RAW_INPUT_BUTTON_ONE;
+	event.Pressed = false;
+	event.PreviouslyPressed = false;
+	event.Axis = axis;
+	event.Value = value;
+
+	return PendingRawInput.Push(event);
+}
+
+//
+// Map every raw input event queued since the last tick
+//
+// Events are processed in the order they were produced, exactly as if
+// they had been fed directly to SetRawButtonState/SetRawAxisValue.
+//
+void InputMapper::ProcessQueuedInput()
+{
+	size_t count = PendingRawInput.GetAvailable();
+	for(size_t i = 0; i < count; ++i)
+	{
+		const RawInputEvent& event = PendingRawInput.Peek(i);
+		if(event.Type == RawInputEvent::EVENT_BUTTON)
+			MapRawButtonState(event.Button, event.Pressed, event.PreviouslyPressed, event.Timestamp);
+		else
+			MapRawAxisValue(event.Axis, event.Value, event.Timestamp);
+	}
+
+	PendingRawInput.Consume(count);
+}
+
+
+//
+// Dispatch input to all registered callbacks
+//
+// Range conversion and filtering are finished here, so this should
+// be called exactly once per tick, followed by Clear(). The finished
+// input is also published to the snapshot read by other threads.
+//
+// Callbacks are only invoked if some input they registered interest in
+// is still present, and dispatch stops as soon as every input has been
+// eaten, so lower-priority callbacks cost nothing on quiet ticks.
+//
+// Once the callbacks are done, any waiters whose input was mapped this
+// tick are resumed; they see the input as mapped, whether or not some
+// callback ate it.
+//
+void InputMapper::Dispatch()
+{
+	Dispatch(GetInputTimestamp());
+}
+
+//
+// Dispatch input as of the given time
+//
+// Held-state waiters and latency tracking measure against this time,
+// which lets replays reproduce them using the recorded timestamps.
+//
+void InputMapper::Dispatch(InputTimestamp now)
+{
+	if(Recording)
+		Recording->RecordDispatch(now);
+
+	// Finish mapping ranges: convert everything in one batch, then
+	// run each range present this tick through its filter chain
+	FlushAccumulatedAxes();
+	PendingRangeConversions.ConvertAll(CurrentMappedInput.RangeValues);
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
 	{
-		const InputContext* context = *iter;
+		// A range absent this tick is at rest, so the history of whichever
+		// chain last filtered it settles as the tick passes
+		if(!CurrentMappedInput.Ranges.test(i))
+		{
+			if(RangeFilterOwners[i])
+				RangeFilterOwners[i]->Rest(RangeFilterStates[i]);
+
+			continue;
+		}
+
+		const AnalogFilterChain* filters = PendingRangeFilters[i];
+		if(!filters || filters->IsEmpty())
+			continue;
 
-		Range range;
-		if(context->MapAxisToRange(axis, range))
+		// Smoothing and acceleration history only means something to the
+		// chain which built it; when a push, pop, or reload hands the range
+		// to a different chain, that chain starts from scratch
+		if(RangeFilterOwners[i] != filters)
 		{
-			CurrentMappedInput.Ranges[range] = context->GetConversions().Convert(range, value * context->GetSensitivity(range));
+			RangeFilterStates[i] = AnalogFilterState();
+			RangeFilterOwners[i] = filters;
+		}
+
+		CurrentMappedInput.RangeValues[i] = filters->Apply(CurrentMappedInput.RangeValues[i], RangeFilterStates[i]);
+	}
+
+	// Other threads see the finished input before any callback runs
+	PublishedInput.Publish(CurrentMappedInput);
+
+	// Callbacks may unregister themselves or each other while the table is
+	// being walked; such removals are deferred until the walk is finished
+	struct DispatchScope
+	{
+		InputMapper& Mapper;
+
+		explicit DispatchScope(InputMapper& mapper) : Mapper(mapper)	{ Mapper.Dispatching = true; }
+		~DispatchScope()												{ Mapper.Dispatching = false; Mapper.EraseDeferredCallbacks(); }
+	} scope(*this);
+
+	if(LatencyTracking)
+	{
+		for(std::vector<InputTimestamp>::const_iterator iter = PendingEventTimestamps.begin(); iter != PendingEventTimestamps.end(); ++iter)
+			EventLatency.Record(now > *iter ? (now - *iter) * 1000 : 0);
+
+		PendingEventTimestamps.clear();
+	}
+
+	MappedInput input = CurrentMappedInput;
+	for(CallbackTableT::const_iterator iter = CallbackTable.begin(); iter != CallbackTable.end(); ++iter)
+	{
+		if(input.IsEmpty())
 			break;
+
+		if(iter->second.Removed || !iter->second.Interest.Matches(input))
+			continue;
+
+		if(LatencyTracking)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			iter->second.Callback(input);
+			CallbackDurations.Record(static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
 		}
+		else
+			iter->second.Callback(input);
 	}
+
+	Waiters.ResumeMatches(CurrentMappedInput, now);
 }
 
+//
+// Add a callback to the dispatch table
+//
+// The callback is interested in all input, so it is invoked on every
+// tick where any input remains by the time its priority comes up.
+//
+void InputMapper::AddCallback(const InputDelegate& callback, int priority)
+{
+	InsertCallback(callback, priority, InputInterest::Everything());
+}
 
 //
-// Dispatch input to all registered callbacks
+// Add a callback to the dispatch table, to be invoked only when input it is interested in is present
 //
-void InputMapper::Dispatch() const
+void InputMapper::AddCallback(const InputDelegate& callback, int priority, const InputInterest& interest)
 {
-	MappedInput input = CurrentMappedInput;
-	for(std::multimap<int, InputCallback>::const_iterator iter = CallbackTable.begin(); iter != CallbackTable.end(); ++iter)
-		(*iter->second)(input);
+	InsertCallback(callback, priority, interest);
 }
 
 //
-// Add a callback to the dispatch table
+// Add a callback to the dispatch table for as long as the returned handle lives
 //
-void InputMapper::AddCallback(InputCallback callback, int priority)
+InputMapper::CallbackRegistration InputMapper::RegisterCallback(const InputDelegate& callback, int priority)
 {
-	CallbackTable.insert(std::make_pair(priority, callback));
+	return CallbackRegistration(this, InsertCallback(callback, priority, InputInterest::Everything()));
+}
+
+//
+// Add a callback with an interest mask for as long as the returned handle lives
+//
+InputMapper::CallbackRegistration InputMapper::RegisterCallback(const InputDelegate& callback, int priority, const InputInterest& interest)
+{
+	return CallbackRegistration(this, InsertCallback(callback, priority, interest));
 }
 
 
+//
+// Suspend a waiter until the next tick on which an action fires
+//
+void InputMapper::WaitForAction(Action action, InputWaiter& waiter)
+{
+	Waiters.WaitForAction(action, waiter);
+}
+
+//
+// Suspend a waiter until a state has been held for the given number of microseconds
+//
+void InputMapper::WaitForStateHeld(State state, InputTimestamp duration, InputWaiter& waiter)
+{
+	Waiters.WaitForStateHeld(state, duration, waiter);
+}
+
+//
+// Cancel a wait in progress, if any
+//
+void InputMapper::CancelWait(InputWaiter& waiter)
+{
+	InputWaiterIndex::Cancel(waiter);
+}
+
+
+//
+// Look up the handle of a loaded input context
+//
+// Handles are assigned when contexts are loaded, and remain valid for
+// the lifetime of the mapper, including across reloads. Returns
+// InvalidContextHandle if no context by the given name was ever loaded.
+//
+ContextHandle InputMapper::GetContextHandle(const std::wstring& name) const
+{
+	std::map<std::wstring, ContextHandle>::const_iterator iter = ContextHandles.find(name);
+	if(iter == ContextHandles.end())
+		return InvalidContextHandle;
+
+	return iter->second;
+}
+
+//
+// Retrieve the table of named actions, states, and ranges for the loaded contexts
+//
+// Like the contexts themselves, this may change when contexts are reloaded,
+// so look up any IDs needed again after a reload.
+//
+const InputIdentifierTable& InputMapper::GetIdentifiers() const
+{
+	return Contexts->Identifiers;
+}
+
 //
 // Push an active input context onto the stack
 //
-void InputMapper::PushContext(const std::wstring& name)
+// The new context claims the inputs it binds in a copy of the table
+// resolved for the stack beneath it, so that mapping never has to walk
+// the stack. This costs one small table copy, plus a few words of combo
+// progress and one timestamp per step of the context's combos, and does
+// not allocate once the stack has been to the same depth before.
+//
+void InputMapper::PushContext(ContextHandle handle)
 {
-	std::map<std::wstring, InputContext*>::iterator iter = InputContexts.find(name);
-	if(iter == InputContexts.end())
-		throw std::exception("Invalid input context pushed");
+	if(handle >= ContextsByHandle.size() || !ContextsByHandle[handle])
+		throw std::runtime_error("Invalid input context pushed");
+
+	if(ActiveContexts.GetCount() >= NoBindingOwner)
+		throw std::runtime_error("Too many input contexts active");
+
+	if(Recording)
+		Recording->RecordPushContext(GetInputTimestamp(), GetContextName(handle));
+
+	ActiveContexts.Push(handle);
+
+	ComboProgress combos;
+	combos.ActiveOffset = ComboActiveSteps.size();
+	combos.StepTimesOffset = ComboStepTimes.size();
+	combos.LastPress = ButtonPresses;
+	ComboStates.Push(combos);
+	ComboActiveSteps.resize(combos.ActiveOffset + ContextsByHandle[handle]->GetCombos().GetWordCount(), 0);
+	ComboStepTimes.resize(combos.StepTimesOffset + ContextsByHandle[handle]->GetCombos().GetStepCount());
+
+	ResolvedBindings resolved = ResolvedStack.Back();
+	ContextsByHandle[handle]->OverlayBindings(resolved, static_cast<unsigned short>(ActiveContexts.GetCount() - 1));
+	ResolvedStack.Push(resolved);
+}
 
-	ActiveContexts.push_front(iter->second);
+//
+// Push an active input context onto the stack by name
+//
+// Prefer looking up the handle once and pushing that; this is
+// provided for tools and other code which only has the name.
+//
+void InputMapper::PushContext(const std::wstring& name)
+{
+	PushContext(GetContextHandle(name));
 }
 
 //
@@ -142,57 +565,475 @@ void InputMapper::PushContext(const std::wstring& name)
 //
 void InputMapper::PopContext()
 {
-	if(ActiveContexts.empty())
-		throw std::exception("Cannot pop input context, no contexts active!");
+	if(ActiveContexts.IsEmpty())
+		throw std::runtime_error("Cannot pop input context, no contexts active!");
+
+	if(Recording)
+		Recording->RecordPopContext(GetInputTimestamp());
+
+	ActiveContexts.Pop();
+	ComboActiveSteps.resize(ComboStates.Back().ActiveOffset);
+	ComboStepTimes.resize(ComboStates.Back().StepTimesOffset);
+	ComboStates.Pop();
+	ResolvedStack.Pop();
+}
+
+
+//
+// Begin appending everything fed to the mapper to a recording
+//
+// Whatever the mapper carries over from earlier ticks is recorded first,
+// so the recording can be replayed into a freshly constructed mapper; see
+// RecordPreamble(). Start between ticks, since input mapped but not yet
+// dispatched is not captured. The recording must outlive the mapper, or
+// recording must be stopped before it goes away.
+//
+void InputMapper::StartRecording(InputRecording& recording)
+{
+	RecordPreamble(recording, GetInputTimestamp());
+	Recording = &recording;
+}
+
+//
+// Stop appending to the current recording, if any
+//
+void InputMapper::StopRecording()
+{
+	Recording = NULL;
+}
+
+
+//
+// Start or stop recording input latency
+//
+// Event latency runs from each raw event's timestamp (taken by the producer
+// for queued events, or on entry for direct calls) until callbacks begin for
+// the tick it was mapped in. Replays carry recorded timestamps, so latency
+// tracking should be off while replaying.
+//
+void InputMapper::EnableLatencyTracking(bool enable)
+{
+	LatencyTracking = enable;
+	PendingEventTimestamps.clear();
+
+	if(enable)
+		PendingEventTimestamps.reserve(RawInputQueueCapacity);
+}
+
+
+//
+// Reload any context files which have changed on disk
+//
+// Only contexts whose files have changed are parsed again; the rest are
+// shared with the current set. The new set is published for the mapping
+// thread to pick up at the end of its current tick, so this may be called
+// from any thread. Returns false if nothing had changed. If any file fails
+// to load, the exception propagates and the current contexts stay in use.
+//
+bool InputMapper::ReloadContexts()
+{
+	std::lock_guard<std::mutex> lock(ReloadLock);
+
+	// Contexts shared from a library have no files of their own
+	if(ContextSourceFile.empty())
+		return false;
+
+	std::shared_ptr<const ContextSet> reloaded;
+	if(ContextSourceIsCompiled)
+		reloaded = ContextSet::LoadCompiled(ContextSourceFile, LatestContexts.get());
+	else
+		reloaded = ContextSet::LoadText(ContextSourceFile, LatestContexts.get());
+
+	if(!reloaded)
+		return false;
+
+	LatestContexts = reloaded;
+
+	// If the mapping thread never picked up the previous reload, it
+	// has been superseded, and is discarded here instead
+	delete PublishedContexts.exchange(new std::shared_ptr<const ContextSet>(reloaded), std::memory_order_acq_rel);
+	return true;
+}
+
+//
+// Start polling the context files for changes on a background thread
+//
+// Files which fail to load (for instance, because an editor is still
+// partway through saving them) are simply retried on the next poll.
+//
+void InputMapper::WatchContextFiles(unsigned pollintervalms)
+{
+	StopWatchingContextFiles();
+
+	WatchStopRequested = false;
+	WatchThread = std::thread([this, pollintervalms]()
+	{
+		std::unique_lock<std::mutex> lock(WatchLock);
+		while(!WatchSignal.wait_for(lock, std::chrono::milliseconds(pollintervalms), [this]() { return WatchStopRequested; }))
+		{
+			lock.unlock();
+			try
+			{
+				ReloadContexts();
+			}
+			catch(...)
+			{
+			}
+			lock.lock();
+		}
+	});
+}
+
+//
+// Stop the background file watcher, if it is running
+//
+void InputMapper::StopWatchingContextFiles()
+{
+	if(!WatchThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(WatchLock);
+		WatchStopRequested = true;
+	}
+
+	WatchSignal.notify_all();
+	WatchThread.join();
+}
+
+
+//
+// Helper: set up mapping state common to all ways of loading contexts
+//
+void InputMapper::Initialize()
+{
+	ResolvedBindings empty;
+	empty.Reset();
+	ResolvedStack.Push(empty);
+
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
+	{
+		PendingRangeFilters[i] = NULL;
+		RangeFilterOwners[i] = NULL;
+	}
+
+	for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+	{
+		AxisAccumulators[i].Mode = RAW_AXIS_MODE_LATEST;
+		AxisAccumulators[i].Total = 0.0;
+		AxisAccumulators[i].SampleCount = 0;
+		AxisAccumulators[i].HistoryCount = 0;
+	}
+}
+
+//
+// Helper: insert a callback into the dispatch table
+//
+// Callbacks added during dispatch may or may not be invoked on that same
+// tick, depending on where their priority places them.
+//
+InputMapper::CallbackTableT::iterator InputMapper::InsertCallback(const InputDelegate& callback, int priority, const InputInterest& interest)
+{
+	CallbackEntry entry;
+	entry.Callback = callback;
+	entry.Interest = interest;
+	entry.Removed = false;
+	return CallbackTable.insert(std::make_pair(priority, entry));
+}
+
+//
+// Helper: remove a callback from the dispatch table
+//
+// Erasing through the iterator is constant time; during dispatch the
+// entry is only flagged, so the walk in progress is not disturbed.
+//
+void InputMapper::RemoveCallback(CallbackTableT::iterator entry)
+{
+	if(!Dispatching)
+	{
+		CallbackTable.erase(entry);
+		return;
+	}
+
+	entry->second.Removed = true;
+	++DeferredCallbackRemovals;
+}
+
+//
+// Helper: erase any callbacks which were removed during dispatch
+//
+void InputMapper::EraseDeferredCallbacks()
+{
+	if(DeferredCallbackRemovals == 0)
+		return;
+
+	for(CallbackTableT::iterator iter = CallbackTable.begin(); iter != CallbackTable.end(); )
+	{
+		if(iter->second.Removed)
+			iter = CallbackTable.erase(iter);
+		else
+			++iter;
+	}
+
+	DeferredCallbackRemovals = 0;
+}
+
+//
+// Helper: record the state carried over from earlier ticks
+//
+// Raw axis settings come first, then the active context stack, then the
+// held buttons and states, the steps each context has reached in its
+// combos, and the history of each range's filter chain. Combo progress
+// already broken by a press elsewhere is left out, as are settings still
+// at their defaults, since a fresh mapper matches them anyway.
+//
+void InputMapper::RecordPreamble(InputRecording& recording, InputTimestamp timestamp) const
+{
+	for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+	{
+		RawInputAxis axis = static_cast<RawInputAxis>(i);
+		if(AxisAccumulators[i].Mode != RAW_AXIS_MODE_LATEST)
+			recording.RecordAxisMode(timestamp, axis, AxisAccumulators[i].Mode);
+
+		if(!AxisAccumulators[i].History.empty())
+			recording.RecordAxisHistory(timestamp, axis, AxisAccumulators[i].History.size());
+	}
+
+	for(size_t i = 0; i < ActiveContexts.GetCount(); ++i)
+		recording.RecordPushContext(timestamp, GetContextName(ActiveContexts[i]));
+
+	if(HeldButtons || CurrentMappedInput.States.any())
+		recording.RecordHeldInput(timestamp, HeldButtons, CurrentMappedInput.States);
+
+	for(size_t i = 0; i < ComboStates.GetCount(); ++i)
+	{
+		const InputContext* context = ContextsByHandle[ActiveContexts[i]];
+		const ComboProgress& progress = ComboStates[i];
+		if(!context || context->GetCombos().IsEmpty() || progress.LastPress != ButtonPresses)
+			continue;
 
-	ActiveContexts.pop_front();
+		recording.RecordComboProgress(timestamp, i, ComboActiveSteps.data() + progress.ActiveOffset, context->GetCombos().GetWordCount(), ComboStepTimes.data() + progress.StepTimesOffset);
+	}
+
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
+	{
+		if(!RangeFilterOwners[i])
+			continue;
+
+		Range range = static_cast<Range>(i);
+		for(size_t j = 0; j < ContextsByHandle.size(); ++j)
+		{
+			if(ContextsByHandle[j] && &ContextsByHandle[j]->GetFilters(range) == RangeFilterOwners[i])
+			{
+				recording.RecordFilterState(timestamp, GetContextName(static_cast<ContextHandle>(j)), range, RangeFilterStates[i].History, AnalogFilterState::MaxStages);
+				break;
+			}
+		}
+	}
 }
 
+//
+// Helper: restore the buttons held and states set when a recording began
+//
+void InputMapper::RestoreHeldInput(unsigned heldbuttons, const std::bitset<STATE_COUNT>& states)
+{
+	HeldButtons = heldbuttons;
+	CurrentMappedInput.States = states;
+}
 
 //
-// Helper: map a button to an action in the active context(s)
+// Helper: restore a combo step reached by the context at a given depth
+//
+// The step counts as reached by the context's latest press, so the next
+// press carries on from it.
 //
-bool InputMapper::MapButtonToAction(RawInputButton button, Action& action) const
+void InputMapper::RestoreComboStep(size_t depth, size_t position, InputTimestamp reached)
 {
-	for(std::list<InputContext*>::const_iterator iter = ActiveContexts.begin(); iter != ActiveContexts.end(); ++iter)
+	const InputContext* context = (depth < ActiveContexts.GetCount()) ? ContextsByHandle[ActiveContexts[depth]] : NULL;
+	if(!context || position >= context->GetCombos().GetStepCount())
+		throw std::runtime_error("Recorded combo progress does not match the active input contexts");
+
+	ComboProgress& progress = ComboStates[depth];
+	ComboActiveSteps[progress.ActiveOffset + (position / 64)] |= 1ull << (position % 64);
+	ComboStepTimes[progress.StepTimesOffset + position] = reached;
+	progress.LastPress = ButtonPresses;
+}
+
+//
+// Helper: restore the history of a context's filter chain for a range
+//
+void InputMapper::RestoreFilterState(const std::wstring& contextname, Range range, const AnalogFilterState& state)
+{
+	ContextHandle handle = GetContextHandle(contextname);
+	if(handle == InvalidContextHandle || !ContextsByHandle[handle])
+		throw std::runtime_error("Recorded filter state belongs to an unknown input context");
+
+	RangeFilterOwners[range] = &ContextsByHandle[handle]->GetFilters(range);
+	RangeFilterStates[range] = state;
+}
+
+//
+// Helper: switch over to the most recently published set of contexts
+//
+// The active stack is kept by handle and resolved again against the new
+// contexts. A context which no longer exists stays on the stack, so that
+// pushes and pops remain balanced, but no longer maps anything.
+//
+void InputMapper::AdoptPublishedContexts()
+{
+	// Cheap check first, so that the common no-reload case costs a single load
+	if(!PublishedContexts.load(std::memory_order_relaxed))
+		return;
+
+	std::shared_ptr<const ContextSet>* published = PublishedContexts.exchange(NULL, std::memory_order_acquire);
+	if(!published)
+		return;
+
+	Contexts = *published;
+	delete published;
+
+	BindContextHandles();
+
+	ResolvedStack.Truncate(1);
+	ComboActiveSteps.clear();
+	ComboStepTimes.clear();
+	for(size_t i = 0; i < ActiveContexts.GetCount(); ++i)
 	{
-		const InputContext* context = *iter;
+		ResolvedBindings resolved = ResolvedStack.Back();
 
-		if(context->MapButtonToAction(button, action))
-			return true;
+		const InputContext* context = ContextsByHandle[ActiveContexts[i]];
+		if(context)
+			context->OverlayBindings(resolved, static_cast<unsigned short>(i));
+
+		ResolvedStack.Push(resolved);
+
+		// Step positions mean nothing once a context's combos may have changed
+		ComboStates[i].ActiveOffset = ComboActiveSteps.size();
+		ComboStates[i].StepTimesOffset = ComboStepTimes.size();
+		ComboStates[i].LastPress = ButtonPresses;
+		if(context)
+		{
+			ComboActiveSteps.resize(ComboActiveSteps.size() + context->GetCombos().GetWordCount(), 0);
+			ComboStepTimes.resize(ComboStepTimes.size() + context->GetCombos().GetStepCount());
+		}
 	}
 
-	return false;
+	// Filter state built by a chain which was not carried over into the new
+	// set is dropped, since a reloaded chain may even reuse its address
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
+	{
+		PendingRangeFilters[i] = NULL;
+
+		bool carriedover = false;
+		for(size_t j = 0; j < ContextsByHandle.size() && !carriedover; ++j)
+			carriedover = ContextsByHandle[j] && &ContextsByHandle[j]->GetFilters(static_cast<Range>(i)) == RangeFilterOwners[i];
+
+		if(!carriedover)
+			RangeFilterOwners[i] = NULL;
+	}
 }
 
 //
-// Helper: map a button to a state in the active context(s)
+// Helper: point every context handle at its context in the current set
+//
+// Names seen for the first time are given the next free handle; handles
+// whose contexts have since been removed are left pointing at nothing.
 //
-bool InputMapper::MapButtonToState(RawInputButton button, State& state) const
+void InputMapper::BindContextHandles()
 {
-	for(std::list<InputContext*>::const_iterator iter = ActiveContexts.begin(); iter != ActiveContexts.end(); ++iter)
+	for(ContextSet::EntryMapT::const_iterator iter = Contexts->Entries.begin(); iter != Contexts->Entries.end(); ++iter)
 	{
-		const InputContext* context = *iter;
+		ContextHandle next = static_cast<ContextHandle>(ContextHandles.size());
+		ContextHandles.insert(std::make_pair(iter->first, next));
+	}
+
+	ContextsByHandle.assign(ContextHandles.size(), NULL);
+	for(std::map<std::wstring, ContextHandle>::const_iterator iter = ContextHandles.begin(); iter != ContextHandles.end(); ++iter)
+		ContextsByHandle[iter->second] = Contexts->Find(iter->first);
+}
 
-		if(context->MapButtonToState(button, state))
-			return true;
+//
+// Helper: find the name a context handle was assigned to
+//
+// This is a linear search, which is fine for the rare callers (recording).
+//
+const std::wstring& InputMapper::GetContextName(ContextHandle handle) const
+{
+	for(std::map<std::wstring, ContextHandle>::const_iterator iter = ContextHandles.begin(); iter != ContextHandles.end(); ++iter)
+	{
+		if(iter->second == handle)
+			return iter->first;
 	}
 
-	return false;
+	throw std::runtime_error("Invalid input context handle");
 }
 
 //
-// Helper: eat all input mapped to a given button
+// Helper: feed a raw axis sample through the axis' accumulation mode
 //
-void InputMapper::MapAndEatButton(RawInputButton button)
+// Accumulating axes only add to a running total here, so high-rate devices
+// cost a couple of arithmetic operations per sample; the total is mapped
+// once per tick by FlushAccumulatedAxes().
+//
+void InputMapper::MapRawAxisValue(RawInputAxis axis, double value, InputTimestamp timestamp)
 {
-	Action action;
-	State state;
+	RawAxisAccumulator& accumulator = AxisAccumulators[axis];
+
+	if(Recording)
+		Recording->RecordAxis(timestamp, axis, value);
+
+	if(LatencyTracking)
+		PendingEventTimestamps.push_back(timestamp);
+
+	if(!accumulator.History.empty())
+	{
+		RawAxisSample& sample = accumulator.History[accumulator.HistoryCount % accumulator.History.size()];
+		sample.Timestamp = timestamp;
+		sample.Value = value;
+		++accumulator.HistoryCount;
+	}
+
+	if(accumulator.Mode == RAW_AXIS_MODE_LATEST)
+	{
+		StageRawAxisValue(axis, value);
+		return;
+	}
+
+	accumulator.Total += value;
+	++accumulator.SampleCount;
+}
 
-	if(MapButtonToAction(button, action))
-		CurrentMappedInput.EatAction(action);
+//
+// Helper: map a raw axis value through the active contexts and stage it for conversion
+//
+void InputMapper::StageRawAxisValue(RawInputAxis axis, double value)
+{
+	unsigned short owner = ResolvedStack.Back().AxisOwners[axis];
+	if(owner == NoBindingOwner)
+		return;
 
-	if(MapButtonToState(button, state))
-		CurrentMappedInput.EatState(state);
+	const InputContext* context = ContextsByHandle[ActiveContexts[owner]];
+	Range range = static_cast<Range>(context->GetTables().Axes[axis]);
+	PendingRangeConversions.Stage(range, value, context->GetSensitivity(range), context->GetConversions().GetConversion(range));
+	PendingRangeFilters[range] = &context->GetFilters(range);
+	CurrentMappedInput.Ranges.set(range);
 }
 
+//
+// Helper: map the combined value of every accumulating axis which saw samples this tick
+//
+void InputMapper::FlushAccumulatedAxes()
+{
+	for(unsigned i = 0; i < RAW_INPUT_AXIS_COUNT; ++i)
+	{
+		const RawAxisAccumulator& accumulator = AxisAccumulators[i];
+		if(accumulator.Mode == RAW_AXIS_MODE_LATEST || accumulator.SampleCount == 0)
+			continue;
+
+		double value = accumulator.Total;
+		if(accumulator.Mode == RAW_AXIS_MODE_AVERAGE)
+			value /= accumulator.SampleCount;
+
+		StageRawAxisValue(static_cast<RawInputAxis>(i), value);
+	}
+}
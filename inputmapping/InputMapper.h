@@ -12,11 +12,28 @@
 // Dependencies
 #include "RawInputConstants.h"
 #include "InputConstants.h"
+#include "MappedInput.h"
+#include "InputSnapshot.h"
+#include "InputLatency.h"
+#include "RawInputQueue.h"
+#include "InputBindings.h"
+#include "RangeConverter.h"
+#include "AnalogFilter.h"
+#include "ComboRecognizer.h"
+#include "SmallStack.h"
+#include "InputDelegate.h"
+#include "InputWaiters.h"
+#include "InputAwaitables.h"
 
 #include <map>
-#include <set>
-#include <list>
+#include <bitset>
+#include <vector>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 
 namespace InputMapping
@@ -24,23 +41,44 @@ namespace InputMapping
 
 	// Forward declarations
 	class InputContext;
+	class InputIdentifierTable;
+	struct ContextSet;
+	class ContextLibrary;
+	class InputRecording;
 
 
-	// Helper structure
-	struct MappedInput
+	//
+	// Set of actions, states, and ranges a callback wants to hear about
+	//
+	// A callback is skipped during dispatch unless at least one input in its
+	// interest set is present. Interest masks are the same shape as mapped
+	// input, so the test is a handful of word-wide ANDs.
+	//
+	struct InputInterest
 	{
-		std::set<Action> Actions;
-		std::set<State> States;
-		std::map<Range, double> Ranges;
-
-		// Consumption helpers
-		void EatAction(Action action)		{ Actions.erase(action); }
-		void EatState(State state)			{ States.erase(state); }
-		void EatRange(Range range)
+		std::bitset<ACTION_COUNT> Actions;
+		std::bitset<STATE_COUNT> States;
+		std::bitset<RANGE_COUNT> Ranges;
+
+		// Construction helpers
+		static InputInterest Everything()
+		{
+			InputInterest ret;
+			ret.Actions.set();
+			ret.States.set();
+			ret.Ranges.set();
+			return ret;
+		}
+
+		// Configuration helpers
+		InputInterest& AddAction(Action action)	{ Actions.set(action); return *this; }
+		InputInterest& AddState(State state)	{ States.set(state); return *this; }
+		InputInterest& AddRange(Range range)	{ Ranges.set(range); return *this; }
+
+		// Query helpers
+		bool Matches(const MappedInput& input) const
 		{
-			std::map<Range, double>::iterator iter = Ranges.find(range);
-			if(iter != Ranges.end())
-				Ranges.erase(iter);
+			return (Actions & input.Actions).any() || (States & input.States).any() || (Ranges & input.Ranges).any();
 		}
 	};
 
@@ -49,11 +87,40 @@ namespace InputMapping
 	typedef void (*InputCallback)(MappedInput& inputs);
 
 
+	//
+	// Ways in which multiple samples of a raw axis within one tick are combined
+	//
+	//  Latest		Every sample is mapped as it arrives; the last one wins
+	//  Sum			Samples are added up and mapped once per tick (relative
+	//				axes such as mouse deltas, so no motion is lost)
+	//  Average		Samples are averaged and mapped once per tick (absolute
+	//				axes such as sticks polled faster than the tick rate)
+	//
+	enum RawAxisMode
+	{
+		RAW_AXIS_MODE_LATEST,
+		RAW_AXIS_MODE_SUM,
+		RAW_AXIS_MODE_AVERAGE,
+	};
+
+
+	//
+	// Timestamped raw axis sample, retained when sample history is enabled
+	//
+	struct RawAxisSample
+	{
+		InputTimestamp Timestamp;
+		double Value;
+	};
+
+
 	class InputMapper
 	{
 	// Construction and destruction
 	public:
 		InputMapper();
+		explicit InputMapper(const std::wstring& compiledimagefile);
+		explicit InputMapper(const ContextLibrary& library);
 		~InputMapper();
 
 	// Raw input interface
@@ -62,33 +129,300 @@ namespace InputMapping
 		void SetRawButtonState(RawInputButton button, bool pressed, bool previouslypressed);
 		void SetRawAxisValue(RawInputAxis axis, double value);
 
+	// Raw axis accumulation interface
+	public:
+		void SetRawAxisMode(RawInputAxis axis, RawAxisMode mode);
+		void EnableRawAxisSampleHistory(RawInputAxis axis, size_t capacity);
+
+		size_t GetRawAxisSampleCount(RawInputAxis axis) const;
+		const RawAxisSample& GetRawAxisSample(RawInputAxis axis, size_t index) const;
+
+	// Queued raw input interface
+	public:
+		// Producer side; may be called from one input thread concurrently with the mapper's own thread
+		bool QueueRawButtonState(RawInputButton button, bool pressed, bool previouslypressed, InputTimestamp timestamp = GetInputTimestamp());
+		bool QueueRawAxisValue(RawInputAxis axis, double value, InputTimestamp timestamp = GetInputTimestamp());
+
+		// Consumer side; call once per simulation tick before dispatching
+		void ProcessQueuedInput();
+
 	// Input dispatching interface
 	public:
-		void Dispatch() const;
+		void Dispatch();
+
+	// Input snapshot interface
+	public:
+		// Readers on any thread may copy the latest dispatched input from here
+		const MappedInputSnapshot& GetInputSnapshot() const
+		{ return PublishedInput; }
+
+	// Latency instrumentation interface
+	public:
+		// Off by default; while on, each raw event's wait from its timestamp
+		// until callbacks start, and each callback's run time, are recorded
+		void EnableLatencyTracking(bool enable);
+
+		// Readers on any thread may inspect these while the mapper runs
+		const LatencyHistogram& GetEventLatency() const
+		{ return EventLatency; }
+
+		const LatencyHistogram& GetCallbackDurations() const
+		{ return CallbackDurations; }
 
 	// Input callback registration interface
 	public:
-		void AddCallback(InputCallback callback, int priority);
+		class CallbackRegistration;
+
+		// Callbacks added this way stay registered for the mapper's lifetime
+		void AddCallback(const InputDelegate& callback, int priority);
+		void AddCallback(const InputDelegate& callback, int priority, const InputInterest& interest);
+
+		// Callbacks registered this way are removed when the returned handle is destroyed
+		CallbackRegistration RegisterCallback(const InputDelegate& callback, int priority);
+		CallbackRegistration RegisterCallback(const InputDelegate& callback, int priority, const InputInterest& interest);
+
+	// Input waiting interface
+	public:
+		// Waiters are resumed from Dispatch(), after the callbacks have run
+		void WaitForAction(Action action, InputWaiter& waiter);
+		void WaitForStateHeld(State state, InputTimestamp duration, InputWaiter& waiter);
+		void CancelWait(InputWaiter& waiter);
+
+#ifdef INPUTMAPPING_HAS_COROUTINES
+		// For use with co_await, e.g. co_await mapper.NextAction(ACTION_ONE)
+		ActionAwaitable NextAction(Action action)
+		{ return ActionAwaitable(Waiters, action); }
+
+		template <typename Rep, typename Period>
+		StateHeldAwaitable StateHeldFor(State state, std::chrono::duration<Rep, Period> duration)
+		{ return StateHeldAwaitable(Waiters, state, ToInputTimestamp(duration)); }
+#endif
 
 	// Context management interface
 	public:
+		ContextHandle GetContextHandle(const std::wstring& name) const;
+		const InputIdentifierTable& GetIdentifiers() const;
+
+		void PushContext(ContextHandle handle);
 		void PushContext(const std::wstring& name);
 		void PopContext();
 
+	// Recording interface
+	public:
+		// Replay with an InputReplayer; see InputRecording.h
+		void StartRecording(InputRecording& recording);
+		void StopRecording();
+
+	// Context reloading interface
+	public:
+		// Safe to call from any thread; the reloaded contexts take effect at the next Clear()
+		bool ReloadContexts();
+
+		void WatchContextFiles(unsigned pollintervalms);
+		void StopWatchingContextFiles();
+
 	// Internal helpers
 	private:
-		bool MapButtonToAction(RawInputButton button, Action& action) const;
-		bool MapButtonToState(RawInputButton button, State& state) const;
-		void MapAndEatButton(RawInputButton button);
+		//
+		// Dispatch table entry; callbacks removed while dispatch is walking
+		// the table are only flagged, and are erased once dispatch finishes
+		//
+		struct CallbackEntry
+		{
+			InputDelegate Callback;
+			InputInterest Interest;
+			bool Removed;
+		};
+
+		typedef std::multimap<int, CallbackEntry> CallbackTableT;
+
+		void Initialize();
+		void AdoptPublishedContexts();
+		void BindContextHandles();
+		const std::wstring& GetContextName(ContextHandle handle) const;
+		void MapRawButtonState(RawInputButton button, bool pressed, bool previouslypressed, InputTimestamp timestamp);
+		void MapRawAxisValue(RawInputAxis axis, double value, InputTimestamp timestamp);
+		void Dispatch(InputTimestamp now);
+		void StageRawAxisValue(RawInputAxis axis, double value);
+		void FlushAccumulatedAxes();
+		CallbackTableT::iterator InsertCallback(const InputDelegate& callback, int priority, const InputInterest& interest);
+		void RemoveCallback(CallbackTableT::iterator entry);
+		void EraseDeferredCallbacks();
+		void RecordPreamble(InputRecording& recording, InputTimestamp timestamp) const;
+		void RestoreHeldInput(unsigned heldbuttons, const std::bitset<STATE_COUNT>& states);
+		void RestoreComboStep(size_t depth, size_t position, InputTimestamp reached);
+		void RestoreFilterState(const std::wstring& contextname, Range range, const AnalogFilterState& state);
+
+		//
+		// Per-axis accumulation state; samples within a tick are folded into
+		// a running total, and optionally also kept in a fixed-size ring
+		//
+		struct RawAxisAccumulator
+		{
+			RawAxisMode Mode;
+			double Total;
+			unsigned SampleCount;
+
+			std::vector<RawAxisSample> History;
+			size_t HistoryCount;
+		};
 
 	// Internal tracking
 	private:
-		std::map<std::wstring, InputContext*> InputContexts;
-		std::list<InputContext*> ActiveContexts;
+		// Contexts in use by the mapping thread, along with the handle
+		// assigned to each context name; handles are never reassigned,
+		// so they stay valid across reloads
+		std::shared_ptr<const ContextSet> Contexts;
+		std::map<std::wstring, ContextHandle> ContextHandles;
+		std::vector<const InputContext*> ContextsByHandle;
+
+		// Handles of the active contexts, from the bottom of the stack to the
+		// top, and one resolved table per stack depth; the back entry reflects
+		// the whole active stack, and the front entry is the empty stack
+		SmallStack<ContextHandle, 8> ActiveContexts;
+		SmallStack<ResolvedBindings, 9> ResolvedStack;
+
+		// Progress through each active context's combos, parallel to the
+		// active stack; each depth's automaton bits and step times are
+		// slices of ComboActiveSteps and ComboStepTimes, sized to the steps
+		// its context's combos actually use. Presses are numbered, so a
+		// context can tell when presses it never saw have broken its combos.
+		struct ComboProgress
+		{
+			size_t ActiveOffset;
+			size_t StepTimesOffset;
+			unsigned long long LastPress;
+		};
 
-		std::multimap<int, InputCallback> CallbackTable;
+		SmallStack<ComboProgress, 8> ComboStates;
+		std::vector<unsigned long long> ComboActiveSteps;
+		std::vector<InputTimestamp> ComboStepTimes;
+		unsigned long long ButtonPresses;
+
+		// Freshly reloaded contexts waiting to be picked up by the mapping
+		// thread; a reload swaps a new box in, and Clear() swaps it out
+		std::atomic<std::shared_ptr<const ContextSet>*> PublishedContexts;
+
+		// Reload bookkeeping, guarded by ReloadLock
+		std::mutex ReloadLock;
+		std::shared_ptr<const ContextSet> LatestContexts;
+		std::wstring ContextSourceFile;
+		bool ContextSourceIsCompiled;
+
+		// Background file watching
+		std::thread WatchThread;
+		std::mutex WatchLock;
+		std::condition_variable WatchSignal;
+		bool WatchStopRequested;
+
+		CallbackTableT CallbackTable;
+		bool Dispatching;
+		unsigned DeferredCallbackRemovals;
+
+		InputWaiterIndex Waiters;
 
 		MappedInput CurrentMappedInput;
+		MappedInputSnapshot PublishedInput;
+		unsigned HeldButtons;		// One bit per raw button currently down
+		RangeConversionBatch PendingRangeConversions;
+		const AnalogFilterChain* PendingRangeFilters[RANGE_COUNT];
+		AnalogFilterState RangeFilterStates[RANGE_COUNT];
+		const AnalogFilterChain* RangeFilterOwners[RANGE_COUNT];		// Chain which built each range's filter state
+
+		RawAxisAccumulator AxisAccumulators[RAW_INPUT_AXIS_COUNT];
+
+		RawInputQueue PendingRawInput;
+
+		InputRecording* Recording;
+
+		// Timestamps of the raw events mapped this tick are held until the
+		// tick is dispatched, when their latency becomes known
+		bool LatencyTracking;
+		std::vector<InputTimestamp> PendingEventTimestamps;
+		LatencyHistogram EventLatency;
+		LatencyHistogram CallbackDurations;
+
+	// Replays feed recorded events in with their original timestamps, and
+	// restore the state recorded in a recording's preamble
+	private:
+		friend class InputReplayer;
+	};
+
+
+	//
+	// Handle which keeps a callback registered for as long as it exists
+	//
+	// Destroying or resetting the handle unregisters the callback in constant
+	// time; this is safe even from within a callback during dispatch. Handles
+	// can be moved but not copied, and must not outlive their mapper.
+	//
+	class InputMapper::CallbackRegistration
+	{
+	// Construction and destruction
+	public:
+		CallbackRegistration()
+			: Mapper(NULL)
+		{
+		}
+
+		CallbackRegistration(CallbackRegistration&& other)
+			: Mapper(other.Mapper),
+			  Entry(other.Entry)
+		{
+			other.Mapper = NULL;
+		}
+
+		CallbackRegistration& operator = (CallbackRegistration&& other)
+		{
+			if(this != &other)
+			{
+				Unregister();
+				Mapper = other.Mapper;
+				Entry = other.Entry;
+				other.Mapper = NULL;
+			}
+
+			return *this;
+		}
+
+		~CallbackRegistration()
+		{
+			Unregister();
+		}
+
+	// Registration interface
+	public:
+		void Unregister()
+		{
+			if(Mapper)
+			{
+				Mapper->RemoveCallback(Entry);
+				Mapper = NULL;
+			}
+		}
+
+		bool IsRegistered() const
+		{ return Mapper != NULL; }
+
+	// Internal helpers
+	private:
+		friend class InputMapper;
+
+		CallbackRegistration(InputMapper* mapper, CallbackTableT::iterator entry)
+			: Mapper(mapper),
+			  Entry(entry)
+		{
+		}
+
+	// Copy semantics are not supported
+	private:
+		CallbackRegistration(const CallbackRegistration&);
+		CallbackRegistration& operator = (const CallbackRegistration&);
+
+	// Internal tracking
+	private:
+		InputMapper* Mapper;
+		CallbackTableT::iterator Entry;
 	};
 
 }
@@ -0,0 +1,546 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Recording raw input to a compact stream, and replaying it through a mapper
+//
+
+#include "pch.h"
+
+#include "InputRecording.h"
+#include "InputMapper.h"
+#include "AnalogFilter.h"
+#include "MappedFile.h"
+#include "FileIO.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+
+using namespace InputMapping;
+
+
+//
+// Constants
+//
+namespace
+{
+	// Leading bytes of every recording; the last one is the format version.
+	// Version 1 recordings lack the preamble, but otherwise read the same.
+	const unsigned char RecordingSignature[] = { 'I', 'M', 'R', 'C', 2 };
+	const unsigned char OldestRecordingVersion = 1;
+
+	// Record types, stored in the low bits of each record's tag byte
+	enum RecordType
+	{
+		RECORD_BUTTON,
+		RECORD_AXIS,
+		RECORD_PUSH_CONTEXT,
+		RECORD_POP_CONTEXT,
+		RECORD_CLEAR,
+		RECORD_DISPATCH,
+		RECORD_AXIS_SETTINGS,
+		RECORD_RESTORE,
+	};
+
+	// Kinds of mapper state restored by the preamble, stored above the
+	// record type in restore records
+	enum RestoreKind
+	{
+		RESTORE_HELD_INPUT,
+		RESTORE_COMBO_PROGRESS,
+		RESTORE_FILTER_STATE,
+	};
+
+	// Flags stored above the record type in button and axis settings records
+	const unsigned RecordTypeMask = 0x07;
+	const unsigned RestoreKindShift = 3;
+	const unsigned ButtonPressedFlag = 0x08;
+	const unsigned ButtonPreviouslyPressedFlag = 0x10;
+	const unsigned AxisHistoryFlag = 0x08;
+}
+
+
+//
+// Construct an empty recording, ready to have records appended
+//
+InputRecording::InputRecording()
+	: Data(RecordingSignature, RecordingSignature + sizeof(RecordingSignature)),
+	  LastTimestamp(0)
+{
+}
+
+//
+// Load a recording previously saved to disk
+//
+InputRecording::InputRecording(const std::wstring& filename)
+	: LastTimestamp(0)
+{
+	MappedFile file(filename);
+
+	const unsigned char* data = static_cast<const unsigned char*>(file.GetData());
+	const size_t versionoffset = sizeof(RecordingSignature) - 1;
+	if(file.GetSize() < sizeof(RecordingSignature) || std::memcmp(data, RecordingSignature, versionoffset) != 0 || data[versionoffset] < OldestRecordingVersion || data[versionoffset] > RecordingSignature[versionoffset])
+		throw std::runtime_error("File is not an input recording, or has an unsupported version");
+
+	Data.assign(data, data + file.GetSize());
+}
+
+
+//
+// Write the recording out to disk
+//
+void InputRecording::Save(const std::wstring& filename) const
+{
+	std::ofstream outfile(NarrowFileName(filename).c_str(), std::ios::binary | std::ios::trunc);
+	if(!outfile)
+		throw std::runtime_error("Failed to open input recording for writing");
+
+	outfile.write(reinterpret_cast<const char*>(&Data[0]), Data.size());
+	if(!outfile)
+		throw std::runtime_error("Failed to write input recording");
+}
+
+
+//
+// Append a raw button state change
+//
+void InputRecording::RecordButton(InputTimestamp timestamp, RawInputButton button, bool pressed, bool previouslypressed)
+{
+	BeginRecord(RECORD_BUTTON | (pressed ? ButtonPressedFlag : 0) | (previouslypressed ? ButtonPreviouslyPressedFlag : 0), timestamp);
+	WriteVarint(button);
+}
+
+//
+// Append a raw axis value
+//
+// Values are stored as their exact bit pattern, so replay is bit-exact.
+//
+void InputRecording::RecordAxis(InputTimestamp timestamp, RawInputAxis axis, double value)
+{
+	BeginRecord(RECORD_AXIS, timestamp);
+	WriteVarint(axis);
+	WriteDouble(value);
+}
+
+//
+// Append a context push; contexts are recorded by name, since handles
+// belong to a single mapper
+//
+void InputRecording::RecordPushContext(InputTimestamp timestamp, const std::wstring& name)
+{
+	BeginRecord(RECORD_PUSH_CONTEXT, timestamp);
+	WriteName(name);
+}
+
+//
+// Append a context pop
+//
+void InputRecording::RecordPopContext(InputTimestamp timestamp)
+{
+	BeginRecord(RECORD_POP_CONTEXT, timestamp);
+}
+
+//
+// Append a call to Clear()
+//
+void InputRecording::RecordClear(InputTimestamp timestamp)
+{
+	BeginRecord(RECORD_CLEAR, timestamp);
+}
+
+//
+// Append a call to Dispatch()
+//
+void InputRecording::RecordDispatch(InputTimestamp timestamp)
+{
+	BeginRecord(RECORD_DISPATCH, timestamp);
+}
+
+//
+// Append a change to how a raw axis accumulates samples
+//
+void InputRecording::RecordAxisMode(InputTimestamp timestamp, RawInputAxis axis, unsigned mode)
+{
+	BeginRecord(RECORD_AXIS_SETTINGS, timestamp);
+	WriteVarint(axis);
+	WriteVarint(mode);
+}
+
+//
+// Append a change to a raw axis' sample history capacity
+//
+void InputRecording::RecordAxisHistory(InputTimestamp timestamp, RawInputAxis axis, size_t capacity)
+{
+	BeginRecord(RECORD_AXIS_SETTINGS | AxisHistoryFlag, timestamp);
+	WriteVarint(axis);
+	WriteVarint(capacity);
+}
+
+
+//
+// Append the buttons held and states set when recording began
+//
+// States are written as a list of IDs, since only a few are set at once.
+//
+void InputRecording::RecordHeldInput(InputTimestamp timestamp, unsigned heldbuttons, const std::bitset<STATE_COUNT>& states)
+{
+	BeginRecord(RECORD_RESTORE | (RESTORE_HELD_INPUT << RestoreKindShift), timestamp);
+	WriteVarint(heldbuttons);
+	WriteVarint(states.count());
+	for(unsigned i = 0; i < STATE_COUNT; ++i)
+	{
+		if(states.test(i))
+			WriteVarint(i);
+	}
+}
+
+//
+// Append the combo steps reached by the context at a given stack depth
+//
+// Each live step is written as its position and the time it was reached,
+// relative to the record's own timestamp.
+//
+void InputRecording::RecordComboProgress(InputTimestamp timestamp, size_t depth, const unsigned long long* active, unsigned wordcount, const InputTimestamp* steptimes)
+{
+	unsigned count = 0;
+	for(unsigned i = 0; i < wordcount; ++i)
+	{
+		for(unsigned long long bits = active[i]; bits; bits &= bits - 1)
+			++count;
+	}
+
+	BeginRecord(RECORD_RESTORE | (RESTORE_COMBO_PROGRESS << RestoreKindShift), timestamp);
+	WriteVarint(depth);
+	WriteVarint(count);
+	for(unsigned position = 0; position < wordcount * 64; ++position)
+	{
+		if(active[position / 64] & (1ull << (position % 64)))
+		{
+			WriteVarint(position);
+			WriteSignedVarint(static_cast<long long>(steptimes[position] - timestamp));
+		}
+	}
+}
+
+//
+// Append the smoothing history of a range's filter chain
+//
+// The chain is identified by the context it belongs to, since its address
+// means nothing to another mapper.
+//
+void InputRecording::RecordFilterState(InputTimestamp timestamp, const std::wstring& contextname, Range range, const double* history, unsigned stagecount)
+{
+	BeginRecord(RECORD_RESTORE | (RESTORE_FILTER_STATE << RestoreKindShift), timestamp);
+	WriteName(contextname);
+	WriteVarint(range);
+	WriteVarint(stagecount);
+	for(unsigned i = 0; i < stagecount; ++i)
+		WriteDouble(history[i]);
+}
+
+
+//
+// Helper: write a record's tag and timestamp
+//
+// Timestamps are stored as a zigzag-encoded difference from the previous
+// record, since queued events may carry slightly older stamps than calls
+// made directly on the mapper.
+//
+void InputRecording::BeginRecord(unsigned tag, InputTimestamp timestamp)
+{
+	long long delta = static_cast<long long>(timestamp - LastTimestamp);
+	LastTimestamp = timestamp;
+
+	Data.push_back(static_cast<unsigned char>(tag));
+	WriteSignedVarint(delta);
+}
+
+//
+// Helper: write an unsigned integer seven bits at a time, low bits first
+//
+void InputRecording::WriteVarint(unsigned long long value)
+{
+	while(value >= 0x80)
+	{
+		Data.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+
+	Data.push_back(static_cast<unsigned char>(value));
+}
+
+//
+// Helper: write a signed integer, zigzag encoded so small magnitudes stay short
+//
+void InputRecording::WriteSignedVarint(long long value)
+{
+	WriteVarint((static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63));
+}
+
+//
+// Helper: write a double as its exact bit pattern, so replay is bit-exact
+//
+void InputRecording::WriteDouble(double value)
+{
+	unsigned long long bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	for(unsigned i = 0; i < sizeof(bits); ++i)
+		Data.push_back(static_cast<unsigned char>(bits >> (i * 8)));
+}
+
+//
+// Helper: write a context name as a length and a sequence of characters
+//
+void InputRecording::WriteName(const std::wstring& name)
+{
+	WriteVarint(name.size());
+	for(std::wstring::const_iterator iter = name.begin(); iter != name.end(); ++iter)
+		WriteVarint(static_cast<unsigned long long>(*iter));
+}
+
+
+//
+// Construct a replayer for a given recording
+//
+// The recording is not copied, so it must outlive the replayer.
+//
+InputReplayer::InputReplayer(const InputRecording& recording)
+	: Recording(recording),
+	  EventCount(0),
+	  TickCount(0)
+{
+}
+
+
+//
+// Feed the whole recording through a mapper
+//
+void InputReplayer::Replay(InputMapper& mapper, InputReplaySpeed speed)
+{
+	const std::vector<unsigned char>& data = Recording.GetData();
+
+	EventCount = 0;
+	TickCount = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	InputTimestamp timestamp = 0;
+	InputTimestamp firsttimestamp = 0;
+
+	size_t position = sizeof(RecordingSignature);
+	while(position < data.size())
+	{
+		bool firstrecord = (position == sizeof(RecordingSignature));
+		unsigned tag = data[position++];
+
+		timestamp += static_cast<InputTimestamp>(ReadSignedVarint(position));
+
+		if(firstrecord)
+			firsttimestamp = timestamp;
+
+		if(speed == INPUT_REPLAY_REAL_TIME && timestamp > firsttimestamp)
+			std::this_thread::sleep_until(start + std::chrono::microseconds(timestamp - firsttimestamp));
+
+		switch(tag & RecordTypeMask)
+		{
+		case RECORD_BUTTON:
+			{
+				unsigned long long button = ReadVarint(position);
+				if(button >= RAW_INPUT_BUTTON_COUNT)
+					throw std::runtime_error("Input recording is corrupt");
+
+				mapper.MapRawButtonState(static_cast<RawInputButton>(button), (tag & ButtonPressedFlag) != 0, (tag & ButtonPreviouslyPressedFlag) != 0, timestamp);
+				++EventCount;
+			}
+			break;
+
+		case RECORD_AXIS:
+			{
+				unsigned long long axis = ReadVarint(position);
+				if(axis >= RAW_INPUT_AXIS_COUNT)
+					throw std::runtime_error("Input recording is corrupt");
+
+				double value = ReadDouble(position);
+				mapper.MapRawAxisValue(static_cast<RawInputAxis>(axis), value, timestamp);
+				++EventCount;
+			}
+			break;
+
+		case RECORD_PUSH_CONTEXT:
+			mapper.PushContext(ReadName(position));
+			break;
+
+		case RECORD_POP_CONTEXT:
+			mapper.PopContext();
+			break;
+
+		case RECORD_CLEAR:
+			mapper.Clear();
+			break;
+
+		case RECORD_DISPATCH:
+			mapper.Dispatch(timestamp);
+			++TickCount;
+			break;
+
+		case RECORD_AXIS_SETTINGS:
+			{
+				unsigned long long axis = ReadVarint(position);
+				unsigned long long setting = ReadVarint(position);
+				if(axis >= RAW_INPUT_AXIS_COUNT)
+					throw std::runtime_error("Input recording is corrupt");
+
+				if(tag & AxisHistoryFlag)
+					mapper.EnableRawAxisSampleHistory(static_cast<RawInputAxis>(axis), static_cast<size_t>(setting));
+				else if(setting <= RAW_AXIS_MODE_AVERAGE)
+					mapper.SetRawAxisMode(static_cast<RawInputAxis>(axis), static_cast<RawAxisMode>(setting));
+				else
+					throw std::runtime_error("Input recording is corrupt");
+			}
+			break;
+
+		case RECORD_RESTORE:
+			ReplayRestore(mapper, tag >> RestoreKindShift, timestamp, position);
+			break;
+
+		default:
+			throw std::runtime_error("Input recording is corrupt");
+		}
+	}
+}
+
+
+//
+// Helper: restore a piece of mapper state recorded in the preamble
+//
+// The mapper checks that the recorded contexts, depths, and step positions
+// exist, so a recording made with different contexts loaded is rejected.
+//
+void InputReplayer::ReplayRestore(InputMapper& mapper, unsigned kind, InputTimestamp timestamp, size_t& position) const
+{
+	switch(kind)
+	{
+	case RESTORE_HELD_INPUT:
+		{
+			unsigned long long heldbuttons = ReadVarint(position);
+			unsigned long long count = ReadVarint(position);
+			if(heldbuttons >> RAW_INPUT_BUTTON_COUNT || count > STATE_COUNT)
+				throw std::runtime_error("Input recording is corrupt");
+
+			std::bitset<STATE_COUNT> states;
+			for(unsigned long long i = 0; i < count; ++i)
+			{
+				unsigned long long state = ReadVarint(position);
+				if(state >= STATE_COUNT)
+					throw std::runtime_error("Input recording is corrupt");
+
+				states.set(static_cast<size_t>(state));
+			}
+
+			mapper.RestoreHeldInput(static_cast<unsigned>(heldbuttons), states);
+		}
+		break;
+
+	case RESTORE_COMBO_PROGRESS:
+		{
+			unsigned long long depth = ReadVarint(position);
+			unsigned long long count = ReadVarint(position);
+			for(unsigned long long i = 0; i < count; ++i)
+			{
+				unsigned long long step = ReadVarint(position);
+				InputTimestamp reached = timestamp + static_cast<InputTimestamp>(ReadSignedVarint(position));
+				mapper.RestoreComboStep(static_cast<size_t>(depth), static_cast<size_t>(step), reached);
+			}
+		}
+		break;
+
+	case RESTORE_FILTER_STATE:
+		{
+			std::wstring name = ReadName(position);
+			unsigned long long range = ReadVarint(position);
+			unsigned long long stagecount = ReadVarint(position);
+			if(range >= RANGE_COUNT || stagecount > AnalogFilterState::MaxStages)
+				throw std::runtime_error("Input recording is corrupt");
+
+			AnalogFilterState state = AnalogFilterState();
+			for(unsigned i = 0; i < stagecount; ++i)
+				state.History[i] = ReadDouble(position);
+
+			mapper.RestoreFilterState(name, static_cast<Range>(range), state);
+		}
+		break;
+
+	default:
+		throw std::runtime_error("Input recording is corrupt");
+	}
+}
+
+
+//
+// Helper: read an unsigned integer written by InputRecording::WriteVarint
+//
+unsigned long long InputReplayer::ReadVarint(size_t& position) const
+{
+	const std::vector<unsigned char>& data = Recording.GetData();
+
+	unsigned long long value = 0;
+	for(unsigned shift = 0; shift < 64; shift += 7)
+	{
+		if(position >= data.size())
+			throw std::runtime_error("Input recording is truncated");
+
+		unsigned char byte = data[position++];
+		value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+		if(!(byte & 0x80))
+			return value;
+	}
+
+	throw std::runtime_error("Input recording is corrupt");
+}
+
+//
+// Helper: read a signed integer written by InputRecording::WriteSignedVarint
+//
+long long InputReplayer::ReadSignedVarint(size_t& position) const
+{
+	unsigned long long zigzag = ReadVarint(position);
+	return static_cast<long long>((zigzag >> 1) ^ (0 - (zigzag & 1)));
+}
+
+//
+// Helper: read a double written by InputRecording::WriteDouble
+//
+double InputReplayer::ReadDouble(size_t& position) const
+{
+	const std::vector<unsigned char>& data = Recording.GetData();
+	if(data.size() - position < sizeof(unsigned long long))
+		throw std::runtime_error("Input recording is truncated");
+
+	unsigned long long bits = 0;
+	for(unsigned i = 0; i < sizeof(bits); ++i)
+		bits |= static_cast<unsigned long long>(data[position++]) << (i * 8);
+
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+//
+// Helper: read a context name written by InputRecording::WriteName
+//
+std::wstring InputReplayer::ReadName(size_t& position) const
+{
+	unsigned long long length = ReadVarint(position);
+	if(length > Recording.GetData().size() - position)
+		throw std::runtime_error("Input recording is corrupt");
+
+	std::wstring name;
+	for(unsigned long long i = 0; i < length; ++i)
+		name.push_back(static_cast<wchar_t>(ReadVarint(position)));
+
+	return name;
+}
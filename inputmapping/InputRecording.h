@@ -0,0 +1,153 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Recording raw input to a compact stream, and replaying it through a mapper
+//
+
+#pragma once
+
+
+// Dependencies
+#include "RawInputConstants.h"
+#include "InputConstants.h"
+#include "RawInputQueue.h"
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	// Forward declarations
+	class InputMapper;
+
+
+	//
+	// Compact binary log of everything fed to an input mapper
+	//
+	// The log holds raw button and axis events along with context pushes and
+	// pops, raw axis settings, and the Clear() and Dispatch() calls marking
+	// tick boundaries, so replaying it into a mapper with the same contexts
+	// loaded reproduces the original session exactly. Each record is a tag
+	// byte, the signed change in timestamp since the previous record, and a
+	// small payload; integers are variable-length encoded, and axis values
+	// are stored bit for bit. Typical records are three or four bytes long.
+	//
+	// Recording may start part way through a session, so it begins with a
+	// preamble capturing everything the mapper carries from tick to tick:
+	// the settings of each raw axis, the active context stack, the buttons
+	// held and states set, progress through any combos, and the history of
+	// any analog filters. Input mapped during the current tick but not yet
+	// dispatched is not captured, so start recording between ticks, or from
+	// a callback.
+	//
+	class InputRecording
+	{
+	// Construction
+	public:
+		InputRecording();
+		explicit InputRecording(const std::wstring& filename);
+
+	// Storage interface
+	public:
+		void Save(const std::wstring& filename) const;
+
+		const std::vector<unsigned char>& GetData() const
+		{ return Data; }
+
+	// Recording interface
+	public:
+		void RecordButton(InputTimestamp timestamp, RawInputButton button, bool pressed, bool previouslypressed);
+		void RecordAxis(InputTimestamp timestamp, RawInputAxis axis, double value);
+		void RecordPushContext(InputTimestamp timestamp, const std::wstring& name);
+		void RecordPopContext(InputTimestamp timestamp);
+		void RecordClear(InputTimestamp timestamp);
+		void RecordDispatch(InputTimestamp timestamp);
+		void RecordAxisMode(InputTimestamp timestamp, RawInputAxis axis, unsigned mode);
+		void RecordAxisHistory(InputTimestamp timestamp, RawInputAxis axis, size_t capacity);
+
+	// Preamble interface
+	public:
+		void RecordHeldInput(InputTimestamp timestamp, unsigned heldbuttons, const std::bitset<STATE_COUNT>& states);
+		void RecordComboProgress(InputTimestamp timestamp, size_t depth, const unsigned long long* active, unsigned wordcount, const InputTimestamp* steptimes);
+		void RecordFilterState(InputTimestamp timestamp, const std::wstring& contextname, Range range, const double* history, unsigned stagecount);
+
+	// Internal helpers
+	private:
+		void BeginRecord(unsigned tag, InputTimestamp timestamp);
+		void WriteVarint(unsigned long long value);
+		void WriteSignedVarint(long long value);
+		void WriteDouble(double value);
+		void WriteName(const std::wstring& name);
+
+	// Internal tracking
+	private:
+		std::vector<unsigned char> Data;
+		InputTimestamp LastTimestamp;
+	};
+
+
+	//
+	// Ways of pacing a replay
+	//
+	//  FullSpeed	Records are fed to the mapper back to back, for profiling
+	//				and for reproducing bugs without waiting
+	//  RealTime	Each record is held back until as much time has passed
+	//				since the replay began as had passed in the recording
+	//
+	enum InputReplaySpeed
+	{
+		INPUT_REPLAY_FULL_SPEED,
+		INPUT_REPLAY_REAL_TIME,
+	};
+
+
+	//
+	// Driver which feeds a recording back through an input mapper
+	//
+	// Raw events and dispatches are handed to the mapper with their recorded
+	// timestamps, so anything timing-sensitive (combos, sample history, held
+	// state waiters, latency figures) behaves exactly as it did when
+	// recorded. The mapper should have the same contexts loaded, and be
+	// freshly constructed or otherwise have no contexts active and nothing
+	// held; the recording's preamble then restores the state the original
+	// mapper was in. Callbacks and waiters run as normal.
+	//
+	class InputReplayer
+	{
+	// Construction
+	public:
+		explicit InputReplayer(const InputRecording& recording);
+
+	// Replay interface
+	public:
+		void Replay(InputMapper& mapper, InputReplaySpeed speed);
+
+		// Totals from the most recent replay
+		size_t GetEventCount() const
+		{ return EventCount; }
+
+		size_t GetTickCount() const
+		{ return TickCount; }
+
+	// Internal helpers
+	private:
+		void ReplayRestore(InputMapper& mapper, unsigned kind, InputTimestamp timestamp, size_t& position) const;
+		unsigned long long ReadVarint(size_t& position) const;
+		long long ReadSignedVarint(size_t& position) const;
+		double ReadDouble(size_t& position) const;
+		std::wstring ReadName(size_t& position) const;
+
+	// Internal tracking
+	private:
+		const InputRecording& Recording;
+		size_t EventCount;
+		size_t TickCount;
+	};
+
+}
+
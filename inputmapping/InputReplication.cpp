@@ -0,0 +1,713 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Compact network encoding of mapped input, and per-player input history
+//
+
+#include "pch.h"
+
+#include "InputReplication.h"
+
+#include <cmath>
+#include <stdexcept>
+
+
+using namespace InputMapping;
+
+
+//
+// Constants
+//
+namespace
+{
+	// Default quantization, suited to ranges converted into [-1, 1]
+	const double DefaultRangeMinimum = -1.0;
+	const double DefaultRangeMaximum = 1.0;
+	const unsigned DefaultRangeBits = 16;
+
+	// Size of the tick number at the start of every packet
+	const unsigned TickBits = 32;
+}
+
+
+//
+// Internal helpers
+//
+namespace
+{
+
+	//
+	// Packs values into a byte buffer, lowest bits first
+	//
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<unsigned char>& out)
+			: Out(out),
+			  Pending(0),
+			  PendingBits(0)
+		{
+			Out.clear();
+		}
+
+		void Write(unsigned long long value, unsigned bits)
+		{
+			while(bits)
+			{
+				unsigned chunk = bits < 32 ? bits : 32;
+				Pending |= (value & ((1ull << chunk) - 1)) << PendingBits;
+				PendingBits += chunk;
+				value >>= chunk;
+				bits -= chunk;
+
+				while(PendingBits >= 8)
+				{
+					Out.push_back(static_cast<unsigned char>(Pending));
+					Pending >>= 8;
+					PendingBits -= 8;
+				}
+			}
+		}
+
+		//
+		// Elias gamma code: small values take few bits, and no upper bound
+		// needs to be agreed in advance; value must be at least 1
+		//
+		void WriteGamma(unsigned long long value)
+		{
+			unsigned length = 0;
+			while((value >> length) > 1)
+				++length;
+
+			Write(0, length);
+			Write(1, 1);
+			Write(value, length);
+		}
+
+		void Finish()
+		{
+			if(PendingBits)
+				Out.push_back(static_cast<unsigned char>(Pending));
+
+			Pending = 0;
+			PendingBits = 0;
+		}
+
+	private:
+		std::vector<unsigned char>& Out;
+		unsigned long long Pending;
+		unsigned PendingBits;
+	};
+
+
+	//
+	// Unpacks values written by BitWriter, throwing if the data runs out
+	//
+	class BitReader
+	{
+	public:
+		BitReader(const unsigned char* data, size_t size)
+			: Data(data),
+			  Size(size),
+			  Position(0)
+		{
+		}
+
+		unsigned long long Read(unsigned bits)
+		{
+			unsigned long long value = 0;
+			for(unsigned i = 0; i < bits; ++i)
+				value |= static_cast<unsigned long long>(ReadBit()) << i;
+
+			return value;
+		}
+
+		unsigned long long ReadGamma()
+		{
+			unsigned length = 0;
+			while(!ReadBit())
+			{
+				if(++length > 63)
+					throw std::runtime_error("Input packet is corrupt");
+			}
+
+			return (1ull << length) | Read(length);
+		}
+
+	private:
+		unsigned ReadBit()
+		{
+			if(Position >= Size * 8)
+				throw std::runtime_error("Input packet is truncated");
+
+			unsigned bit = (Data[Position / 8] >> (Position % 8)) & 1;
+			++Position;
+			return bit;
+		}
+
+	private:
+		const unsigned char* Data;
+		size_t Size;
+		size_t Position;
+	};
+
+
+	//
+	// Write a bitset as the number of set bits, then the gaps between them
+	//
+	template <size_t BitCount>
+	void WriteSparse(BitWriter& writer, const std::bitset<BitCount>& bits)
+	{
+		size_t count = bits.count();
+		writer.WriteGamma(count + 1);
+
+		size_t previous = 0;
+		for(size_t i = 0; count; ++i)
+		{
+			if(!bits.test(i))
+				continue;
+
+			writer.WriteGamma(i + 1 - previous);
+			previous = i + 1;
+			--count;
+		}
+	}
+
+	template <size_t BitCount>
+	std::bitset<BitCount> ReadSparse(BitReader& reader)
+	{
+		std::bitset<BitCount> bits;
+
+		unsigned long long count = reader.ReadGamma() - 1;
+		if(count > BitCount)
+			throw std::runtime_error("Input packet is corrupt");
+
+		unsigned long long next = 0;
+		for(unsigned long long i = 0; i < count; ++i)
+		{
+			next += reader.ReadGamma();
+			if(next > BitCount)
+				throw std::runtime_error("Input packet is corrupt");
+
+			bits.set(static_cast<size_t>(next - 1));
+		}
+
+		return bits;
+	}
+
+
+	//
+	// Write one tick of input as a delta from a baseline tick
+	//
+	// Actions only last a single tick, so they are sent in full; states and
+	// range presence are sent as the bits which changed. Ranges present in
+	// both ticks are sent as the zigzag-encoded change in their quantized
+	// value, so an unmoved axis costs a single bit.
+	//
+	void WriteTick(BitWriter& writer, const InputEncoding& encoding, const MappedInput& input, const MappedInput& baseline)
+	{
+		WriteSparse(writer, input.Actions);
+		WriteSparse(writer, input.States ^ baseline.States);
+		WriteSparse(writer, input.Ranges ^ baseline.Ranges);
+
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+		{
+			if(!input.Ranges.test(i))
+				continue;
+
+			Range range = static_cast<Range>(i);
+			unsigned code = encoding.QuantizeRange(range, input.RangeValues[i]);
+
+			if(baseline.Ranges.test(i))
+			{
+				long long delta = static_cast<long long>(code) - static_cast<long long>(encoding.QuantizeRange(range, baseline.RangeValues[i]));
+				writer.WriteGamma(((static_cast<unsigned long long>(delta) << 1) ^ static_cast<unsigned long long>(delta >> 63)) + 1);
+			}
+			else
+				writer.Write(code, encoding.GetRangeBits(range));
+		}
+	}
+
+	void ReadTick(BitReader& reader, const InputEncoding& encoding, MappedInput& input, const MappedInput& baseline)
+	{
+		input = MappedInput();
+		input.Actions = ReadSparse<ACTION_COUNT>(reader);
+		input.States = ReadSparse<STATE_COUNT>(reader) ^ baseline.States;
+		input.Ranges = ReadSparse<RANGE_COUNT>(reader) ^ baseline.Ranges;
+
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+		{
+			if(!input.Ranges.test(i))
+				continue;
+
+			Range range = static_cast<Range>(i);
+			unsigned bits = encoding.GetRangeBits(range);
+			unsigned long long code;
+
+			if(baseline.Ranges.test(i))
+			{
+				unsigned long long zigzag = reader.ReadGamma() - 1;
+				long long delta = static_cast<long long>((zigzag >> 1) ^ (0 - (zigzag & 1)));
+				code = static_cast<unsigned long long>(encoding.QuantizeRange(range, baseline.RangeValues[i]) + delta);
+			}
+			else
+				code = reader.Read(bits);
+
+			if(code > ((1ull << bits) - 1))
+				throw std::runtime_error("Input packet is corrupt");
+
+			input.RangeValues[i] = encoding.DequantizeRange(range, static_cast<unsigned>(code));
+		}
+	}
+
+}
+
+
+//
+// Construct an encoding with the default quantization for every range
+//
+InputEncoding::InputEncoding()
+{
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
+	{
+		Minimums[i] = DefaultRangeMinimum;
+		Maximums[i] = DefaultRangeMaximum;
+		Bits[i] = DefaultRangeBits;
+	}
+}
+
+//
+// Choose the span and precision with which a range is sent
+//
+void InputEncoding::SetRangeQuantization(Range range, double minimum, double maximum, unsigned bits)
+{
+	if(bits < 1 || bits > 32 || !(maximum > minimum))
+		throw std::runtime_error("Invalid range quantization");
+
+	Minimums[range] = minimum;
+	Maximums[range] = maximum;
+	Bits[range] = bits;
+}
+
+
+//
+// Convert a range value to its wire representation
+//
+unsigned InputEncoding::QuantizeRange(Range range, double value) const
+{
+	double maxcode = static_cast<double>((1ull << Bits[range]) - 1);
+	double scaled = (value - Minimums[range]) / (Maximums[range] - Minimums[range]) * maxcode;
+
+	if(!(scaled > 0.0))
+		return 0;
+	if(scaled >= maxcode)
+		return static_cast<unsigned>(maxcode);
+
+	return static_cast<unsigned>(std::floor(scaled + 0.5));
+}
+
+//
+// Convert a wire representation back to a range value
+//
+double InputEncoding::DequantizeRange(Range range, unsigned code) const
+{
+	double maxcode = static_cast<double>((1ull << Bits[range]) - 1);
+	return Minimums[range] + (Maximums[range] - Minimums[range]) * (code / maxcode);
+}
+
+//
+// Round every range in a tick's input to exactly what the receiver will see
+//
+// Senders keep their history in this form, so the baselines that deltas
+// are computed against match bit for bit on both ends.
+//
+void InputEncoding::Quantize(MappedInput& input) const
+{
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
+	{
+		Range range = static_cast<Range>(i);
+		input.RangeValues[i] = input.Ranges.test(i) ? DequantizeRange(range, QuantizeRange(range, input.RangeValues[i])) : 0.0;
+	}
+}
+
+
+//
+// Construct an empty history
+//
+InputHistory::InputHistory()
+	: HasConfirmed(false),
+	  ContiguousTick(0),
+	  Mispredicted(false),
+	  EarliestMisprediction(0)
+{
+	for(unsigned i = 0; i < Capacity; ++i)
+	{
+		Slots[i].Tick = 0;
+		Slots[i].Confirmed = false;
+		Slots[i].Predicted = false;
+		Slots[i].Input = MappedInput();
+	}
+}
+
+
+//
+// Store the real input for a tick
+//
+// Ticks which have already been confirmed, or which are too old to still
+// be in the history, are ignored; redundant packets make both common.
+//
+void InputHistory::Confirm(unsigned tick, const MappedInput& input)
+{
+	Slot& slot = GetSlot(tick);
+	if(slot.Tick == tick && slot.Confirmed)
+		return;
+
+	if(slot.Tick > tick || (HasConfirmed && tick <= ContiguousTick))
+		return;
+
+	if(slot.Tick == tick && slot.Predicted && !IsSameInput(slot.Input, input))
+	{
+		if(!Mispredicted || tick < EarliestMisprediction)
+			EarliestMisprediction = tick;
+
+		Mispredicted = true;
+	}
+
+	slot.Tick = tick;
+	slot.Confirmed = true;
+	slot.Predicted = false;
+	slot.Input = input;
+
+	if(!HasConfirmed)
+	{
+		HasConfirmed = true;
+		ContiguousTick = tick;
+	}
+
+	while(FindConfirmed(ContiguousTick + 1))
+		++ContiguousTick;
+}
+
+
+//
+// Retrieve the real input for a tick, if it has arrived
+//
+const MappedInput* InputHistory::FindConfirmed(unsigned tick) const
+{
+	const Slot& slot = GetSlot(tick);
+	if(slot.Tick != tick || !slot.Confirmed)
+		return NULL;
+
+	return &slot.Input;
+}
+
+//
+// Retrieve the input to simulate a tick with
+//
+// This is the real input if it has arrived, and a prediction otherwise.
+// Predictions are remembered so they can be checked when the real input
+// turns up.
+//
+const MappedInput& InputHistory::GetInput(unsigned tick)
+{
+	Slot& slot = GetSlot(tick);
+	if(slot.Tick == tick && (slot.Confirmed || slot.Predicted))
+		return slot.Input;
+
+	MappedInput prediction = MappedInput();
+	for(unsigned age = 1; age < Capacity && age <= tick; ++age)
+	{
+		const MappedInput* source = FindConfirmed(tick - age);
+		if(source)
+		{
+			prediction = *source;
+			prediction.Actions.reset();
+			break;
+		}
+	}
+
+	slot.Tick = tick;
+	slot.Confirmed = false;
+	slot.Predicted = true;
+	slot.Input = prediction;
+	return slot.Input;
+}
+
+
+//
+// Retrieve the newest tick through which the history has no gaps
+//
+bool InputHistory::GetNewestContiguousTick(unsigned& tick) const
+{
+	if(!HasConfirmed)
+		return false;
+
+	tick = ContiguousTick;
+	return true;
+}
+
+
+//
+// Retrieve and reset the earliest mispredicted tick
+//
+bool InputHistory::TakeMisprediction(unsigned& earliesttick)
+{
+	if(!Mispredicted)
+		return false;
+
+	earliesttick = EarliestMisprediction;
+	Mispredicted = false;
+	return true;
+}
+
+
+//
+// Helper: compare two ticks of input, ignoring values of absent ranges
+//
+bool InputHistory::IsSameInput(const MappedInput& first, const MappedInput& second)
+{
+	if(first.Actions != second.Actions || first.States != second.States || first.Ranges != second.Ranges)
+		return false;
+
+	for(unsigned i = 0; i < RANGE_COUNT; ++i)
+	{
+		if(first.Ranges.test(i) && first.RangeValues[i] != second.RangeValues[i])
+			return false;
+	}
+
+	return true;
+}
+
+
+//
+// Construct a sender with nothing sent or acknowledged yet
+//
+// The encoding is not copied, so it must outlive the sender.
+//
+InputSender::InputSender(const InputEncoding& encoding)
+	: Encoding(encoding),
+	  HasBaseline(false)
+{
+	Baseline.Tick = 0;
+	Baseline.Input = MappedInput();
+}
+
+
+//
+// Queue a tick of local input for sending
+//
+// Ticks must be added in order with no gaps.
+//
+void InputSender::AddTick(unsigned tick, const MappedInput& input)
+{
+	if(!Unacknowledged.empty() ? tick != Unacknowledged.back().Tick + 1 : (HasBaseline && tick != Baseline.Tick + 1))
+		throw std::runtime_error("Input ticks must be sent in order");
+
+	if(Unacknowledged.size() >= InputHistory::Capacity - 1)
+		throw std::runtime_error("Too many input ticks are awaiting acknowledgement");
+
+	SentTick sent;
+	sent.Tick = tick;
+	sent.Input = input;
+	Encoding.Quantize(sent.Input);
+	Unacknowledged.push_back(sent);
+}
+
+//
+// Build a packet carrying every unacknowledged tick
+//
+// Layout: first tick number, tick count + 1, a flag saying whether a
+// baseline follows, the distance back to the baseline tick, then each tick
+// in order. With nothing outstanding the packet is still valid, and just
+// tells the receiver nothing new has happened.
+//
+void InputSender::WritePacket(std::vector<unsigned char>& packet) const
+{
+	BitWriter writer(packet);
+
+	unsigned firsttick = Unacknowledged.empty() ? (HasBaseline ? Baseline.Tick + 1 : 0) : Unacknowledged.front().Tick;
+	writer.Write(firsttick, TickBits);
+	writer.WriteGamma(Unacknowledged.size() + 1);
+
+	writer.Write(HasBaseline ? 1 : 0, 1);
+	if(HasBaseline)
+		writer.WriteGamma(firsttick - Baseline.Tick);
+
+	const MappedInput empty = MappedInput();
+	const MappedInput* previous = HasBaseline ? &Baseline.Input : &empty;
+	for(std::deque<SentTick>::const_iterator iter = Unacknowledged.begin(); iter != Unacknowledged.end(); ++iter)
+	{
+		WriteTick(writer, Encoding, iter->Input, *previous);
+		previous = &iter->Input;
+	}
+
+	writer.Finish();
+}
+
+
+//
+// Note that the receiver has every tick up to and including the given one
+//
+// Stale or duplicated acknowledgements are harmless.
+//
+void InputSender::Acknowledge(unsigned tick)
+{
+	while(!Unacknowledged.empty() && Unacknowledged.front().Tick <= tick)
+	{
+		Baseline = Unacknowledged.front();
+		HasBaseline = true;
+		Unacknowledged.pop_front();
+	}
+}
+
+//
+// Apply an acknowledgement packet written by InputReceiver
+//
+void InputSender::ReadAcknowledgementPacket(const unsigned char* data, size_t size)
+{
+	BitReader reader(data, size);
+	Acknowledge(static_cast<unsigned>(reader.Read(TickBits)));
+}
+
+
+//
+// Construct a receiver which feeds the given player's history
+//
+// The encoding and history are not copied, so they must outlive the
+// receiver.
+//
+InputReceiver::InputReceiver(const InputEncoding& encoding, InputHistory& history)
+	: Encoding(encoding),
+	  History(history)
+{
+}
+
+
+//
+// Decode a packet and confirm its ticks into the history
+//
+// Returns false if the packet's baseline is no longer in the history, in
+// which case it is ignored; a later packet built against a newer
+// acknowledgement will carry the same ticks. Malformed packets throw.
+//
+bool InputReceiver::ReadPacket(const unsigned char* data, size_t size)
+{
+	BitReader reader(data, size);
+
+	unsigned firsttick = static_cast<unsigned>(reader.Read(TickBits));
+	unsigned long long count = reader.ReadGamma() - 1;
+	if(count >= InputHistory::Capacity)
+		throw std::runtime_error("Input packet is corrupt");
+
+	MappedInput previous = MappedInput();
+	if(reader.Read(1))
+	{
+		unsigned baselinetick = firsttick - static_cast<unsigned>(reader.ReadGamma());
+
+		const MappedInput* baseline = History.FindConfirmed(baselinetick);
+		if(!baseline)
+			return false;
+
+		previous = *baseline;
+	}
+
+	MappedInput decoded;
+	for(unsigned i = 0; i < count; ++i)
+	{
+		ReadTick(reader, Encoding, decoded, previous);
+		History.Confirm(firsttick + i, decoded);
+		previous = decoded;
+	}
+
+	return true;
+}
+
+
+//
+// Retrieve the tick to acknowledge back to the sender
+//
+bool InputReceiver::GetAcknowledgement(unsigned& tick) const
+{
+	return History.GetNewestContiguousTick(tick);
+}
+
+//
+// Build a packet acknowledging everything received so far
+//
+// Returns false if nothing has been received yet.
+//
+bool InputReceiver::WriteAcknowledgementPacket(std::vector<unsigned char>& packet) const
+{
+	unsigned tick;
+	if(!GetAcknowledgement(tick))
+		return false;
+
+	BitWriter writer(packet);
+	writer.Write(tick, TickBits);
+	writer.Finish();
+	return true;
+}
+
+
+//
+// Construct a channel with the given delay and loss pattern
+//
+// Packets arrive after latency calls to Deliver(); if dropinterval is
+// nonzero, every dropinterval'th packet sent is lost.
+//
+InputLoopbackChannel::InputLoopbackChannel(unsigned latency, unsigned dropinterval)
+	: Latency(latency),
+	  DropInterval(dropinterval),
+	  SentCount(0)
+{
+}
+
+
+//
+// Put a packet on the wire
+//
+void InputLoopbackChannel::Send(const std::vector<unsigned char>& packet)
+{
+	++SentCount;
+	if(DropInterval && SentCount % DropInterval == 0)
+		return;
+
+	InFlightPacket inflight;
+	inflight.Remaining = Latency;
+	inflight.Data = packet;
+	InFlight.push_back(inflight);
+}
+
+//
+// Advance time by one step, letting any packets which are due arrive
+//
+void InputLoopbackChannel::Deliver()
+{
+	for(std::deque<InFlightPacket>::iterator iter = InFlight.begin(); iter != InFlight.end(); ++iter)
+	{
+		if(iter->Remaining)
+			--iter->Remaining;
+	}
+
+	while(!InFlight.empty() && !InFlight.front().Remaining)
+	{
+		Arrived.push_back(InFlight.front().Data);
+		InFlight.pop_front();
+	}
+}
+
+//
+// Take the next packet which has arrived, if any
+//
+bool InputLoopbackChannel::Receive(std::vector<unsigned char>& packet)
+{
+	if(Arrived.empty())
+		return false;
+
+	packet.swap(Arrived.front());
+	Arrived.pop_front();
+	return true;
+}
+
@@ -0,0 +1,250 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Compact network encoding of mapped input, and per-player input history
+//
+
+#pragma once
+
+
+// Dependencies
+#include "InputConstants.h"
+#include "MappedInput.h"
+
+#include <deque>
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	//
+	// How each range's value is quantized for the wire
+	//
+	// Values are clamped to [Minimum, Maximum] and mapped onto Bits bits.
+	// Both ends of a connection must use the same settings. By default every
+	// range covers [-1, 1] with 16 bits, which suits converted ranges.
+	//
+	class InputEncoding
+	{
+	// Construction
+	public:
+		InputEncoding();
+
+	// Configuration interface
+	public:
+		void SetRangeQuantization(Range range, double minimum, double maximum, unsigned bits);
+
+	// Quantization interface
+	public:
+		unsigned QuantizeRange(Range range, double value) const;
+		double DequantizeRange(Range range, unsigned code) const;
+
+		unsigned GetRangeBits(Range range) const
+		{ return Bits[range]; }
+
+		void Quantize(MappedInput& input) const;
+
+	// Internal tracking
+	private:
+		double Minimums[RANGE_COUNT];
+		double Maximums[RANGE_COUNT];
+		unsigned Bits[RANGE_COUNT];
+	};
+
+
+	//
+	// Ring of one player's input by tick, with prediction of missing ticks
+	//
+	// Confirmed input is stored as it arrives from the network. When the
+	// simulation needs a tick which has not arrived yet, the newest earlier
+	// confirmed tick is repeated with its actions removed (states and ranges
+	// tend to persist, while actions are one-off events). If the real input
+	// later turns out to differ from what was predicted, the earliest such
+	// tick is remembered so the simulation can rewind and re-simulate from it.
+	//
+	// The simulation must not run more than Capacity ticks ahead of the
+	// newest confirmed input, or predictions start overwriting the history
+	// which is needed to decode incoming packets.
+	//
+	class InputHistory
+	{
+	// Constants
+	public:
+		static const unsigned Capacity = 64;
+
+	// Construction
+	public:
+		InputHistory();
+
+	// History interface
+	public:
+		void Confirm(unsigned tick, const MappedInput& input);
+
+		const MappedInput* FindConfirmed(unsigned tick) const;
+		const MappedInput& GetInput(unsigned tick);
+
+		// Newest tick for which it and every earlier tick have been confirmed
+		bool GetNewestContiguousTick(unsigned& tick) const;
+
+	// Re-simulation hook
+	public:
+		//
+		// Retrieve and reset the earliest tick whose prediction proved wrong;
+		// returns false if every prediction since the last call held up
+		//
+		bool TakeMisprediction(unsigned& earliesttick);
+
+	// Internal helpers
+	private:
+		struct Slot
+		{
+			unsigned Tick;
+			bool Confirmed;
+			bool Predicted;
+			MappedInput Input;		// Confirmed input, or what was predicted
+		};
+
+		Slot& GetSlot(unsigned tick)
+		{ return Slots[tick % Capacity]; }
+
+		const Slot& GetSlot(unsigned tick) const
+		{ return Slots[tick % Capacity]; }
+
+		static bool IsSameInput(const MappedInput& first, const MappedInput& second);
+
+	// Internal tracking
+	private:
+		Slot Slots[Capacity];
+
+		bool HasConfirmed;
+		unsigned ContiguousTick;
+
+		bool Mispredicted;
+		unsigned EarliestMisprediction;
+	};
+
+
+	//
+	// Sending end of one player's input stream
+	//
+	// Every tick's input is kept until the receiver acknowledges it, and each
+	// packet carries every tick not yet acknowledged, so a lost packet costs
+	// nothing but latency: its contents ride along in the next one. The first
+	// tick in a packet is delta encoded against the newest acknowledged tick,
+	// which the receiver is known to have, and each later tick against the
+	// one before it.
+	//
+	// At most InputHistory::Capacity - 1 ticks may await acknowledgement;
+	// a game which gets that far ahead of its peer should stall rather than
+	// add more ticks.
+	//
+	// Actions are written as a sparse list, states and range presence as a
+	// sparse list of bits that changed, and ranges present in both ticks as
+	// the signed change in their quantized value; a tick in which nothing
+	// changes costs a few bits.
+	//
+	class InputSender
+	{
+	// Construction
+	public:
+		explicit InputSender(const InputEncoding& encoding);
+
+	// Sending interface
+	public:
+		void AddTick(unsigned tick, const MappedInput& input);
+		void WritePacket(std::vector<unsigned char>& packet) const;
+
+		size_t GetUnacknowledgedCount() const
+		{ return Unacknowledged.size(); }
+
+	// Acknowledgement interface
+	public:
+		void Acknowledge(unsigned tick);
+		void ReadAcknowledgementPacket(const unsigned char* data, size_t size);
+
+	// Internal tracking
+	private:
+		struct SentTick
+		{
+			unsigned Tick;
+			MappedInput Input;
+		};
+
+		const InputEncoding& Encoding;
+
+		std::deque<SentTick> Unacknowledged;
+
+		bool HasBaseline;
+		SentTick Baseline;
+	};
+
+
+	//
+	// Receiving end of one player's input stream
+	//
+	// Decoded ticks are confirmed into the player's input history. The
+	// acknowledgement to send back is the newest tick through which the
+	// history is complete.
+	//
+	class InputReceiver
+	{
+	// Construction
+	public:
+		InputReceiver(const InputEncoding& encoding, InputHistory& history);
+
+	// Receiving interface
+	public:
+		bool ReadPacket(const unsigned char* data, size_t size);
+
+	// Acknowledgement interface
+	public:
+		bool GetAcknowledgement(unsigned& tick) const;
+		bool WriteAcknowledgementPacket(std::vector<unsigned char>& packet) const;
+
+	// Internal tracking
+	private:
+		const InputEncoding& Encoding;
+		InputHistory& History;
+	};
+
+
+	//
+	// In-process stand-in for a network connection carrying input packets
+	//
+	// Packets are delivered in order after a fixed number of Deliver() calls,
+	// and every Nth packet can be dropped, which is enough to exercise the
+	// redundancy and acknowledgement logic without any real sockets.
+	//
+	class InputLoopbackChannel
+	{
+	// Construction
+	public:
+		InputLoopbackChannel(unsigned latency, unsigned dropinterval);
+
+	// Channel interface
+	public:
+		void Send(const std::vector<unsigned char>& packet);
+		void Deliver();
+		bool Receive(std::vector<unsigned char>& packet);
+
+	// Internal tracking
+	private:
+		struct InFlightPacket
+		{
+			unsigned Remaining;
+			std::vector<unsigned char> Data;
+		};
+
+		unsigned Latency;
+		unsigned DropInterval;
+		unsigned SentCount;
+
+		std::deque<InFlightPacket> InFlight;
+		std::deque<std::vector<unsigned char> > Arrived;
+	};
+
+}
+
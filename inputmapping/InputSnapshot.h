@@ -0,0 +1,121 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Lock-free publication of mapped input to reader threads
+//
+
+#pragma once
+
+
+// Dependencies
+#include "MappedInput.h"
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+
+namespace InputMapping
+{
+
+	//
+	// Slot holding the most recently published copy of a tick's mapped input
+	//
+	// This is a sequence lock: the single writer bumps a sequence number to
+	// an odd value, stores the new contents, and bumps it again to the next
+	// even value. Readers copy the contents out between two reads of the
+	// sequence number, and retry if it changed or was odd. The writer never
+	// waits for anything, so no number of readers can stall input processing;
+	// a reader only repeats its copy if a publish lands in the middle of it.
+	//
+	// The contents are kept as relaxed atomic words, so the racing copies
+	// are well defined rather than relying on the platform's behavior.
+	//
+	class MappedInputSnapshot
+	{
+	// Construction
+	public:
+		MappedInputSnapshot()
+			: Sequence(0)
+		{
+			for(unsigned i = 0; i < WordCount; ++i)
+				Words[i].store(0, std::memory_order_relaxed);
+		}
+
+	// Writer interface
+	public:
+		//
+		// Publish a new copy; only one thread may ever call this
+		//
+		void Publish(const MappedInput& input)
+		{
+			unsigned long long words[WordCount] = { 0 };
+			std::memcpy(words, &input, sizeof(MappedInput));
+
+			unsigned long long sequence = Sequence.load(std::memory_order_relaxed);
+			Sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			for(unsigned i = 0; i < WordCount; ++i)
+				Words[i].store(words[i], std::memory_order_relaxed);
+
+			Sequence.store(sequence + 2, std::memory_order_release);
+		}
+
+	// Reader interface
+	public:
+		//
+		// Attempt a single consistent copy; fails if a publish was in progress
+		//
+		// On success, the publish count is returned as well, so callers can
+		// tell whether anything new has been published since their last read.
+		//
+		bool TryRead(MappedInput& out, unsigned long long& publishcount) const
+		{
+			unsigned long long before = Sequence.load(std::memory_order_acquire);
+			if(before & 1)
+				return false;
+
+			unsigned long long words[WordCount];
+			for(unsigned i = 0; i < WordCount; ++i)
+				words[i] = Words[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(Sequence.load(std::memory_order_relaxed) != before)
+				return false;
+
+			std::memcpy(&out, words, sizeof(MappedInput));
+			publishcount = before / 2;
+			return true;
+		}
+
+		//
+		// Copy the latest published input, retrying until a copy is consistent
+		//
+		unsigned long long Read(MappedInput& out) const
+		{
+			unsigned long long publishcount;
+			while(!TryRead(out, publishcount))
+				;
+
+			return publishcount;
+		}
+
+	// Internal constants
+	private:
+		static_assert(std::is_trivially_copyable<MappedInput>::value, "Mapped input must be copyable as raw words");
+
+		static const unsigned WordCount = (sizeof(MappedInput) + sizeof(unsigned long long) - 1) / sizeof(unsigned long long);
+
+	// Internal tracking
+	private:
+		// The sequence number gets its own cache line, since every reader
+		// polls it and the writer touches it twice per publish
+		alignas(64) std::atomic<unsigned long long> Sequence;
+		alignas(64) std::atomic<unsigned long long> Words[WordCount];
+	};
+
+}
+
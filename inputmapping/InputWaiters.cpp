@@ -0,0 +1,222 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Index of code suspended until particular input arrives
+//
+
+#include "pch.h"
+
+#include "InputWaiters.h"
+#include "InputMapper.h"
+
+
+using namespace InputMapping;
+
+
+//
+// Construct an index with nothing waiting
+//
+InputWaiterIndex::InputWaiterIndex()
+{
+	for(unsigned i = 0; i < ACTION_COUNT; ++i)
+		ActionWaiters[i] = NULL;
+
+	for(unsigned i = 0; i < STATE_COUNT; ++i)
+		StateWaiters[i] = NULL;
+}
+
+
+//
+// Suspend a waiter until the next tick on which the given action fires
+//
+void InputWaiterIndex::WaitForAction(Action action, InputWaiter& waiter)
+{
+	Cancel(waiter);
+	Link(ActionWaiters[action], waiter);
+
+	if(!ActionListed.test(action))
+	{
+		ActionListed.set(action);
+		WaitedActions.push_back(action);
+	}
+}
+
+//
+// Suspend a waiter until the given state has been held continuously for a duration
+//
+// The hold is timed from the first tick the waiter sees the state, so a
+// state which is already held when the wait begins counts from then.
+//
+void InputWaiterIndex::WaitForStateHeld(State state, InputTimestamp duration, InputWaiter& waiter)
+{
+	Cancel(waiter);
+	waiter.Duration = duration;
+	waiter.Holding = false;
+	Link(StateWaiters[state], waiter);
+
+	if(!StateListed.test(state))
+	{
+		StateListed.set(state);
+		WaitedStates.push_back(state);
+	}
+}
+
+//
+// Stop a waiter from waiting, if it is; it will not be resumed
+//
+void InputWaiterIndex::Cancel(InputWaiter& waiter)
+{
+	if(waiter.IsWaiting())
+		Unlink(waiter);
+}
+
+
+//
+// Resume every waiter whose input is present in this tick's mapped input
+//
+// Resumed code may start new waits, which can append to the lists of
+// waited inputs. Only the inputs listed on entry are examined, and inputs
+// with nobody left waiting are removed once resumption is over, so the
+// lists never shift underneath the loops.
+//
+void InputWaiterIndex::ResumeMatches(const MappedInput& input, InputTimestamp now)
+{
+	size_t actioncount = WaitedActions.size();
+	size_t statecount = WaitedStates.size();
+
+	for(size_t i = 0; i < actioncount; ++i)
+	{
+		unsigned action = WaitedActions[i];
+		if(ActionWaiters[action] && input.Actions.test(action))
+		{
+			// Detach the whole list before resuming anything, so that
+			// waits started during resumption land in a fresh list
+			InputWaiter* ready = ActionWaiters[action];
+			ActionWaiters[action] = NULL;
+			ResumeAll(ready);
+		}
+	}
+
+	for(size_t i = 0; i < statecount; ++i)
+	{
+		unsigned state = WaitedStates[i];
+		if(!StateWaiters[state])
+			continue;
+
+		if(!input.States.test(state))
+		{
+			// Released; any holds in progress start over
+			if(StateHeldLastTick.test(state))
+			{
+				for(InputWaiter* waiter = StateWaiters[state]; waiter; waiter = waiter->Next)
+					waiter->Holding = false;
+
+				StateHeldLastTick.reset(state);
+			}
+
+			continue;
+		}
+
+		StateHeldLastTick.set(state);
+
+		InputWaiter* ready = NULL;
+		for(InputWaiter* waiter = StateWaiters[state]; waiter; )
+		{
+			InputWaiter* next = waiter->Next;
+
+			if(!waiter->Holding)
+			{
+				waiter->Holding = true;
+				waiter->HeldSince = now;
+			}
+
+			if(now - waiter->HeldSince >= waiter->Duration)
+			{
+				Unlink(*waiter);
+				Link(ready, *waiter);
+			}
+
+			waiter = next;
+		}
+
+		ResumeAll(ready);
+	}
+
+	for(size_t i = 0; i < WaitedActions.size(); )
+	{
+		unsigned action = WaitedActions[i];
+		if(ActionWaiters[action])
+		{
+			++i;
+			continue;
+		}
+
+		ActionListed.reset(action);
+		WaitedActions[i] = WaitedActions.back();
+		WaitedActions.pop_back();
+	}
+
+	for(size_t i = 0; i < WaitedStates.size(); )
+	{
+		unsigned state = WaitedStates[i];
+		if(StateWaiters[state])
+		{
+			++i;
+			continue;
+		}
+
+		StateListed.reset(state);
+		StateHeldLastTick.reset(state);
+		WaitedStates[i] = WaitedStates.back();
+		WaitedStates.pop_back();
+	}
+}
+
+
+//
+// Helper: link a waiter at the head of a list
+//
+void InputWaiterIndex::Link(InputWaiter*& head, InputWaiter& waiter)
+{
+	waiter.Next = head;
+	waiter.PreviousLink = &head;
+	if(head)
+		head->PreviousLink = &waiter.Next;
+
+	head = &waiter;
+}
+
+//
+// Helper: unlink a waiter from whichever list it is in
+//
+void InputWaiterIndex::Unlink(InputWaiter& waiter)
+{
+	*waiter.PreviousLink = waiter.Next;
+	if(waiter.Next)
+		waiter.Next->PreviousLink = waiter.PreviousLink;
+
+	waiter.Next = NULL;
+	waiter.PreviousLink = NULL;
+}
+
+//
+// Helper: resume each waiter in a detached list
+//
+// Waiters are unlinked one at a time just before being resumed, so a
+// resumed waiter may safely cancel others still in the list.
+//
+void InputWaiterIndex::ResumeAll(InputWaiter* ready)
+{
+	if(ready)
+		ready->PreviousLink = &ready;
+
+	while(ready)
+	{
+		InputWaiter* waiter = ready;
+		Unlink(*waiter);
+		waiter->Resume(waiter->Context);
+	}
+}
+
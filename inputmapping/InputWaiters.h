@@ -0,0 +1,111 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Index of code suspended until particular input arrives
+//
+
+#pragma once
+
+
+// Dependencies
+#include "InputConstants.h"
+#include "RawInputQueue.h"
+
+#include <bitset>
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	// Forward declarations
+	struct MappedInput;
+
+
+	//
+	// Record of a single suspended wait on some input
+	//
+	// The owner fills in Resume and Context; when the awaited input shows up
+	// during dispatch, the waiter is unlinked and Resume(Context) is called.
+	// Waiters are linked intrusively, so waiting never allocates; the owner
+	// must keep the record alive (and in place) until it has been resumed or
+	// cancelled.
+	//
+	struct InputWaiter
+	{
+		void (*Resume)(void* context);
+		void* Context;
+
+		// Maintained by the index
+		InputWaiter* Next;
+		InputWaiter** PreviousLink;
+		InputTimestamp Duration;
+		InputTimestamp HeldSince;
+		bool Holding;
+
+		InputWaiter()
+			: Resume(NULL),
+			  Context(NULL),
+			  Next(NULL),
+			  PreviousLink(NULL),
+			  Duration(0),
+			  HeldSince(0),
+			  Holding(false)
+		{
+		}
+
+		bool IsWaiting() const
+		{ return PreviousLink != NULL; }
+	};
+
+
+	//
+	// Waiters indexed by the action or state they are waiting for
+	//
+	// Each tick only the IDs which actually have waiters are examined, so
+	// any amount of suspended code costs nothing until its input arrives.
+	// Waiters resumed on a tick are detached first; if they wait again
+	// straight away, the new wait is for a later tick.
+	//
+	class InputWaiterIndex
+	{
+	// Construction
+	public:
+		InputWaiterIndex();
+
+	// Waiting interface
+	public:
+		void WaitForAction(Action action, InputWaiter& waiter);
+		void WaitForStateHeld(State state, InputTimestamp duration, InputWaiter& waiter);
+
+		static void Cancel(InputWaiter& waiter);
+
+	// Dispatch interface
+	public:
+		void ResumeMatches(const MappedInput& input, InputTimestamp now);
+
+	// Internal helpers
+	private:
+		static void Link(InputWaiter*& head, InputWaiter& waiter);
+		static void Unlink(InputWaiter& waiter);
+		static void ResumeAll(InputWaiter* ready);
+
+	// Internal tracking
+	private:
+		InputWaiter* ActionWaiters[ACTION_COUNT];
+		InputWaiter* StateWaiters[STATE_COUNT];
+
+		// IDs which have (or recently had) waiters, so dispatch
+		// never needs to scan the whole ID space
+		std::vector<unsigned> WaitedActions;
+		std::vector<unsigned> WaitedStates;
+		std::bitset<ACTION_COUNT> ActionListed;
+		std::bitset<STATE_COUNT> StateListed;
+
+		std::bitset<STATE_COUNT> StateHeldLastTick;
+	};
+
+}
+
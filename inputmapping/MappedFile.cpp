@@ -0,0 +1,118 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Wrapper class for read-only memory mapped files
+//
+
+#include "pch.h"
+
+#include "MappedFile.h"
+#include "FileIO.h"
+
+#include <stdexcept>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+using namespace InputMapping;
+
+
+#ifdef WIN32
+
+//
+// Open a file and map its entire contents into memory for reading
+//
+MappedFile::MappedFile(const std::wstring& filename)
+	: File(INVALID_HANDLE_VALUE),
+	  Mapping(NULL),
+	  Data(NULL),
+	  Size(0)
+{
+	// Delete sharing lets a newer version of the file be renamed into place
+	// while this one is still mapped
+	File = ::CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(File == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open file for mapping");
+
+	LARGE_INTEGER size;
+	if(!::GetFileSizeEx(File, &size) || size.QuadPart == 0)
+	{
+		::CloseHandle(File);
+		throw std::runtime_error("Cannot map an empty file");
+	}
+
+	Mapping = ::CreateFileMapping(File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(Mapping)
+		Data = ::MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if(!Data)
+	{
+		if(Mapping)
+			::CloseHandle(Mapping);
+		::CloseHandle(File);
+		throw std::runtime_error("Failed to map file into memory");
+	}
+
+	Size = static_cast<size_t>(size.QuadPart);
+}
+
+//
+// Unmap and close the file
+//
+MappedFile::~MappedFile()
+{
+	::UnmapViewOfFile(Data);
+	::CloseHandle(Mapping);
+	::CloseHandle(File);
+}
+
+#else
+
+//
+// Open a file and map its entire contents into memory for reading
+//
+MappedFile::MappedFile(const std::wstring& filename)
+	: Descriptor(-1),
+	  Data(NULL),
+	  Size(0)
+{
+	Descriptor = ::open(NarrowFileName(filename).c_str(), O_RDONLY);
+	if(Descriptor < 0)
+		throw std::runtime_error("Failed to open file for mapping");
+
+	struct stat info;
+	if(::fstat(Descriptor, &info) != 0 || info.st_size == 0)
+	{
+		::close(Descriptor);
+		throw std::runtime_error("Cannot map an empty file");
+	}
+
+	void* data = ::mmap(NULL, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, Descriptor, 0);
+	if(data == MAP_FAILED)
+	{
+		::close(Descriptor);
+		throw std::runtime_error("Failed to map file into memory");
+	}
+
+	Data = data;
+	Size = static_cast<size_t>(info.st_size);
+}
+
+//
+// Unmap and close the file
+//
+MappedFile::~MappedFile()
+{
+	::munmap(const_cast<void*>(Data), Size);
+	::close(Descriptor);
+}
+
+#endif
+
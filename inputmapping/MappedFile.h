@@ -0,0 +1,49 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Wrapper class for read-only memory mapped files
+//
+
+#pragma once
+
+
+// Dependencies
+#include <string>
+#include <cstddef>
+
+
+namespace InputMapping
+{
+
+	class MappedFile
+	{
+	// Construction and destruction
+	public:
+		explicit MappedFile(const std::wstring& filename);
+		~MappedFile();
+
+	// Access interface
+	public:
+		const void* GetData() const
+		{ return Data; }
+
+		size_t GetSize() const
+		{ return Size; }
+
+	// Internal tracking
+	private:
+#ifdef WIN32
+		HANDLE File;
+		HANDLE Mapping;
+#else
+		int Descriptor;
+#endif
+
+		const void* Data;
+		size_t Size;
+	};
+
+}
+
@@ -0,0 +1,58 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Record of all input mapped during a single tick
+//
+
+#pragma once
+
+
+// Dependencies
+#include "InputConstants.h"
+
+#include <bitset>
+
+
+namespace InputMapping
+{
+
+	// Helper structure
+	//
+	// Fixed-size record of all mapped input for a frame. Actions and states
+	// are bitsets, and ranges are a dense value array plus a presence mask,
+	// so clearing, copying, and querying never touch the heap.
+	//
+	struct MappedInput
+	{
+		std::bitset<ACTION_COUNT> Actions;
+		std::bitset<STATE_COUNT> States;
+		std::bitset<RANGE_COUNT> Ranges;
+		double RangeValues[RANGE_COUNT];
+
+		// Query helpers
+		bool HasAction(Action action) const	{ return Actions.test(action); }
+		bool HasState(State state) const	{ return States.test(state); }
+		bool HasRange(Range range) const	{ return Ranges.test(range); }
+		double GetRange(Range range) const	{ return Ranges.test(range) ? RangeValues[range] : 0.0; }
+
+		// Mapping helpers
+		void SetAction(Action action)		{ Actions.set(action); }
+		void SetState(State state)			{ States.set(state); }
+		void SetRange(Range range, double value)
+		{
+			RangeValues[range] = value;
+			Ranges.set(range);
+		}
+
+		// Consumption helpers
+		void EatAction(Action action)		{ Actions.reset(action); }
+		void EatState(State state)			{ States.reset(state); }
+		void EatRange(Range range)			{ Ranges.reset(range); }
+
+		bool IsEmpty() const				{ return Actions.none() && States.none() && Ranges.none(); }
+	};
+
+}
+
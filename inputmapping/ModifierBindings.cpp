@@ -0,0 +1,155 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Button bindings which depend on which other buttons are held (Shift+1, etc.)
+//
+
+#include "pch.h"
+
+#include "ModifierBindings.h"
+
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INPUTMAPPING_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+
+using namespace InputMapping;
+
+
+//
+// Constants
+//
+namespace
+{
+	// Button ID stored in padding entries, which no raw button can equal
+	const unsigned NoButton = 0xffffffff;
+}
+
+
+//
+// Construct an empty table, which never matches anything
+//
+ModifierBindingTable::ModifierBindingTable()
+	: Count(0)
+{
+	for(unsigned i = 0; i < Width; ++i)
+	{
+		Buttons[i] = NoButton;
+		RequiredButtons[i] = 0;
+		ExcludedButtons[i] = 0;
+		MappedActions[i] = UnmappedBinding;
+		MappedStates[i] = UnmappedBinding;
+	}
+
+	for(unsigned i = 0; i <= RAW_INPUT_BUTTON_COUNT; ++i)
+		ButtonStarts[i] = 0;
+}
+
+
+//
+// Pack a set of binding descriptions into the table
+//
+// Bindings are bucketed by button with a counting sort, which keeps the
+// order they were listed in within each button.
+//
+void ModifierBindingTable::Build(const ModifierBindingDescription* bindings, unsigned count)
+{
+	if(count > MaxBindings)
+		throw std::runtime_error("Too many modifier bindings specified for a single context");
+
+	unsigned buttoncounts[RAW_INPUT_BUTTON_COUNT] = { 0 };
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const ModifierBindingDescription& binding = bindings[i];
+		if(binding.Button >= RAW_INPUT_BUTTON_COUNT || (binding.RequiredButtons >> (RAW_INPUT_BUTTON_COUNT - 1)) > 1 || (binding.ExcludedButtons >> (RAW_INPUT_BUTTON_COUNT - 1)) > 1)
+			throw std::runtime_error("Out of range input ID in modifier binding");
+
+		if((binding.MappedAction != UnmappedBinding && binding.MappedAction >= ACTION_COUNT) || (binding.MappedState != UnmappedBinding && binding.MappedState >= STATE_COUNT))
+			throw std::runtime_error("Out of range input ID in modifier binding");
+
+		++buttoncounts[binding.Button];
+	}
+
+	ButtonStarts[0] = 0;
+	for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+		ButtonStarts[i + 1] = ButtonStarts[i] + buttoncounts[i];
+
+	unsigned next[RAW_INPUT_BUTTON_COUNT];
+	for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+		next[i] = ButtonStarts[i];
+
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const ModifierBindingDescription& binding = bindings[i];
+		unsigned slot = next[binding.Button]++;
+
+		Buttons[slot] = binding.Button;
+		RequiredButtons[slot] = binding.RequiredButtons;
+		ExcludedButtons[slot] = binding.ExcludedButtons;
+		MappedActions[slot] = binding.MappedAction;
+		MappedStates[slot] = binding.MappedState;
+	}
+
+	Count = count;
+}
+
+
+//
+// Helper: test one vector's worth of entries against a pressed button
+//
+// Returns a mask with bit N set if entry (first + N) is on the button,
+// has all of its required modifiers held, and none of its excluded ones.
+//
+unsigned ModifierBindingTable::MatchVector(unsigned first, RawInputButton button, unsigned heldbuttons) const
+{
+#if defined(__AVX2__)
+	__m256i b = _mm256_set1_epi32(static_cast<int>(button));
+	__m256i held = _mm256_set1_epi32(static_cast<int>(heldbuttons));
+	__m256i zero = _mm256_setzero_si256();
+
+	__m256i required = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(RequiredButtons + first));
+	__m256i excluded = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ExcludedButtons + first));
+
+	__m256i match = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Buttons + first)), b);
+	match = _mm256_and_si256(match, _mm256_cmpeq_epi32(_mm256_and_si256(held, required), required));
+	match = _mm256_and_si256(match, _mm256_cmpeq_epi32(_mm256_and_si256(held, excluded), zero));
+
+	return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(match)));
+#elif defined(INPUTMAPPING_USE_SSE2)
+	__m128i b = _mm_set1_epi32(static_cast<int>(button));
+	__m128i held = _mm_set1_epi32(static_cast<int>(heldbuttons));
+	__m128i zero = _mm_setzero_si128();
+
+	unsigned ret = 0;
+	for(unsigned half = 0; half < VectorWidth; half += 4)
+	{
+		__m128i required = _mm_loadu_si128(reinterpret_cast<const __m128i*>(RequiredButtons + first + half));
+		__m128i excluded = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ExcludedButtons + first + half));
+
+		__m128i match = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Buttons + first + half)), b);
+		match = _mm_and_si128(match, _mm_cmpeq_epi32(_mm_and_si128(held, required), required));
+		match = _mm_and_si128(match, _mm_cmpeq_epi32(_mm_and_si128(held, excluded), zero));
+
+		ret |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(match))) << half;
+	}
+
+	return ret;
+#else
+	unsigned ret = 0;
+	for(unsigned i = 0; i < VectorWidth; ++i)
+	{
+		unsigned index = first + i;
+		if(Buttons[index] == static_cast<unsigned>(button) && (heldbuttons & RequiredButtons[index]) == RequiredButtons[index] && !(heldbuttons & ExcludedButtons[index]))
+			ret |= 1u << i;
+	}
+
+	return ret;
+#endif
+}
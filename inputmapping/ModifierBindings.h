@@ -0,0 +1,156 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Button bindings which depend on which other buttons are held (Shift+1, etc.)
+//
+
+#pragma once
+
+
+// Dependencies
+#include "RawInputConstants.h"
+#include "InputConstants.h"
+#include "InputBindings.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+// Capacity of a single context's modifier binding table; this may be
+// raised by defining it before including any input mapping headers
+#ifndef INPUTMAPPING_MAX_MODIFIER_BINDINGS
+#define INPUTMAPPING_MAX_MODIFIER_BINDINGS 512
+#endif
+
+
+namespace InputMapping
+{
+
+	static_assert(RAW_INPUT_BUTTON_COUNT <= 32, "Modifier sets are stored as a 32-bit mask of raw buttons");
+
+
+	//
+	// Serializable description of one modifier binding
+	//
+	// The binding applies when its button is pressed while every button in
+	// the required mask is held and no button in the excluded mask is held.
+	// Masks have one bit per raw button. Either output may be UnmappedBinding;
+	// several bindings may share the same button and masks, in which case
+	// all of their outputs are mapped.
+	//
+	struct ModifierBindingDescription
+	{
+		unsigned Button;
+		unsigned RequiredButtons;
+		unsigned ExcludedButtons;
+		unsigned short MappedAction;
+		unsigned short MappedState;
+	};
+
+
+	//
+	// Packed table of one context's modifier bindings
+	//
+	// Bindings are sorted by button and stored as parallel arrays, so all of
+	// a button's candidates sit next to each other and are tested several at
+	// a time with vector compares against the held-button mask. The arrays
+	// are padded with entries which match no button, so the vector loop can
+	// always run a whole vector past the last real entry.
+	//
+	class ModifierBindingTable
+	{
+	// Constants
+	public:
+		static const unsigned MaxBindings = INPUTMAPPING_MAX_MODIFIER_BINDINGS;
+
+	// Construction
+	public:
+		ModifierBindingTable();
+
+	// Configuration interface
+	public:
+		void Build(const ModifierBindingDescription* bindings, unsigned count);
+
+		bool IsEmpty() const
+		{ return Count == 0; }
+
+		bool HasBindings(RawInputButton button) const
+		{ return ButtonStarts[button] != ButtonStarts[button + 1]; }
+
+	// Matching interface
+	public:
+		//
+		// Invoke a functor with the (action, state) outputs of every binding
+		// on the given button whose modifier requirements are met by the held
+		// mask; returns the number of bindings matched
+		//
+		template <typename EmitT>
+		unsigned Match(RawInputButton button, unsigned heldbuttons, EmitT emit) const
+		{
+			unsigned matched = 0;
+			unsigned end = ButtonStarts[button + 1];
+			for(unsigned i = ButtonStarts[button]; i < end; i += VectorWidth)
+			{
+				for(unsigned mask = MatchVector(i, button, heldbuttons); mask; mask &= mask - 1)
+				{
+					unsigned index = i + LowestBit(mask);
+					if(index >= end)
+						break;
+
+					emit(MappedActions[index], MappedStates[index]);
+					++matched;
+				}
+			}
+
+			return matched;
+		}
+
+		//
+		// Invoke a functor with the outputs of every binding on the given
+		// button, regardless of modifiers; used to release whatever a button
+		// may have mapped to
+		//
+		template <typename EmitT>
+		void MatchAnyModifiers(RawInputButton button, EmitT emit) const
+		{
+			for(unsigned i = ButtonStarts[button]; i < ButtonStarts[button + 1]; ++i)
+				emit(MappedActions[i], MappedStates[i]);
+		}
+
+	// Internal constants
+	private:
+		static const unsigned VectorWidth = 8;
+		static const unsigned Width = (MaxBindings + (2 * VectorWidth) - 1) & ~(VectorWidth - 1);
+
+	// Internal helpers
+	private:
+		unsigned MatchVector(unsigned first, RawInputButton button, unsigned heldbuttons) const;
+
+		static unsigned LowestBit(unsigned mask)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+		}
+
+	// Internal tracking
+	private:
+		alignas(32) unsigned Buttons[Width];
+		alignas(32) unsigned RequiredButtons[Width];
+		alignas(32) unsigned ExcludedButtons[Width];
+		unsigned short MappedActions[Width];
+		unsigned short MappedStates[Width];
+
+		unsigned ButtonStarts[RAW_INPUT_BUTTON_COUNT + 1];
+		unsigned Count;
+	};
+
+}
+
@@ -0,0 +1,145 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Helper for spreading independent pieces of work across worker threads
+//
+
+#include "pch.h"
+
+#include "ParallelFor.h"
+
+
+using namespace InputMapping;
+
+
+//
+// Start the worker threads, which wait for the first batch
+//
+WorkerPool::WorkerPool(unsigned threadcount)
+	: BatchInvoke(NULL),
+	  BatchWork(NULL),
+	  BatchCount(0),
+	  BatchNext(0),
+	  BatchFailed(false),
+	  BatchNumber(0),
+	  BusyWorkers(0),
+	  StopRequested(false)
+{
+	for(unsigned i = 1; i < threadcount; ++i)
+		Threads.push_back(std::thread([this]() { WorkerThread(); }));
+}
+
+//
+// Stop and join the worker threads
+//
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(BatchLock);
+		StopRequested = true;
+	}
+
+	BatchReady.notify_all();
+
+	for(std::vector<std::thread>::iterator iter = Threads.begin(); iter != Threads.end(); ++iter)
+		iter->join();
+}
+
+
+//
+// Hand a batch to the workers, help with it, and wait for them to finish
+//
+// Every worker must check in before this returns, even one which wakes
+// too late to find anything left to do, since the batch refers to the
+// caller's work functor.
+//
+void WorkerPool::Run(size_t count, InvokeFunc invoke, void* work)
+{
+	if(count == 0)
+		return;
+
+	std::lock_guard<std::mutex> runlock(RunLock);
+
+	{
+		std::lock_guard<std::mutex> lock(BatchLock);
+		BatchInvoke = invoke;
+		BatchWork = work;
+		BatchCount = count;
+		BatchNext = 0;
+		BatchFailed = false;
+		BatchFailure = std::exception_ptr();
+		BusyWorkers = static_cast<unsigned>(Threads.size());
+		++BatchNumber;
+	}
+
+	BatchReady.notify_all();
+
+	DoWork();
+
+	std::exception_ptr failure;
+	{
+		std::unique_lock<std::mutex> lock(BatchLock);
+		BatchDone.wait(lock, [this]() { return BusyWorkers == 0; });
+
+		failure = BatchFailure;
+		BatchFailure = std::exception_ptr();
+	}
+
+	if(failure)
+		std::rethrow_exception(failure);
+}
+
+//
+// Body of each worker thread: sleep until a batch arrives, then work on it
+//
+void WorkerPool::WorkerThread()
+{
+	unsigned long long lastbatch = 0;
+
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(BatchLock);
+			BatchReady.wait(lock, [this, lastbatch]() { return StopRequested || BatchNumber != lastbatch; });
+			if(StopRequested)
+				return;
+
+			lastbatch = BatchNumber;
+		}
+
+		DoWork();
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(BatchLock);
+			last = (--BusyWorkers == 0);
+		}
+
+		if(last)
+			BatchDone.notify_one();
+	}
+}
+
+//
+// Pull items from the current batch until none remain
+//
+void WorkerPool::DoWork()
+{
+	for(size_t i = BatchNext++; i < BatchCount && !BatchFailed; i = BatchNext++)
+	{
+		try
+		{
+			BatchInvoke(BatchWork, i);
+		}
+		catch(...)
+		{
+			std::lock_guard<std::mutex> lock(BatchLock);
+			if(!BatchFailure)
+				BatchFailure = std::current_exception();
+			BatchFailed = true;
+		}
+	}
+}
+
@@ -0,0 +1,119 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Helper for spreading independent pieces of work across worker threads
+//
+
+#pragma once
+
+
+// Dependencies
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	//
+	// Persistent set of worker threads for work which recurs every tick
+	//
+	// The threads are started once and sleep between batches, so running a
+	// batch costs a wakeup per thread rather than a thread creation. One
+	// batch runs at a time; concurrent callers simply take turns.
+	//
+	class WorkerPool
+	{
+	// Construction and destruction
+	public:
+		// The thread count includes the calling thread, which always helps
+		explicit WorkerPool(unsigned threadcount = std::thread::hardware_concurrency());
+		~WorkerPool();
+
+	// Work interface
+	public:
+		//
+		// Invoke work(i) for every i in [0, count) across the pool's threads
+		//
+		// Workers pull indices from a shared counter, so uneven work items
+		// still balance out. This does not return until every item is
+		// finished. If any item throws, remaining items are skipped and the
+		// first exception is rethrown to the caller.
+		//
+		template <typename WorkFunc>
+		void ParallelFor(size_t count, WorkFunc work)
+		{
+			Run(count, &InvokeWork<WorkFunc>, &work);
+		}
+
+		unsigned GetThreadCount() const
+		{ return static_cast<unsigned>(Threads.size()) + 1; }
+
+	// Copy semantics are not supported
+	private:
+		WorkerPool(const WorkerPool&);
+		WorkerPool& operator = (const WorkerPool&);
+
+	// Internal helpers
+	private:
+		typedef void (*InvokeFunc)(void* work, size_t index);
+
+		template <typename WorkFunc>
+		static void InvokeWork(void* work, size_t index)
+		{ (*static_cast<WorkFunc*>(work))(index); }
+
+		void Run(size_t count, InvokeFunc invoke, void* work);
+		void WorkerThread();
+		void DoWork();
+
+	// Internal tracking
+	private:
+		std::vector<std::thread> Threads;
+
+		// Held by a caller for the whole of its batch
+		std::mutex RunLock;
+
+		// The current batch; written under BatchLock before the workers are
+		// woken, and left alone until they have all finished with it
+		InvokeFunc BatchInvoke;
+		void* BatchWork;
+		size_t BatchCount;
+		std::atomic<size_t> BatchNext;
+		std::atomic<bool> BatchFailed;
+		std::exception_ptr BatchFailure;
+
+		// Worker wakeup and completion, guarded by BatchLock
+		std::mutex BatchLock;
+		std::condition_variable BatchReady;
+		std::condition_variable BatchDone;
+		unsigned long long BatchNumber;
+		unsigned BusyWorkers;
+		bool StopRequested;
+	};
+
+
+	//
+	// Invoke work(i) for every i in [0, count), using up to one thread per core
+	//
+	// This starts threads just for the one call, so it suits occasional work
+	// such as loading; keep a WorkerPool for work done every tick.
+	//
+	template <typename WorkFunc>
+	void ParallelFor(size_t count, WorkFunc work)
+	{
+		size_t threadcount = std::thread::hardware_concurrency();
+		if(threadcount > count)
+			threadcount = count;
+
+		WorkerPool workers(static_cast<unsigned>(threadcount));
+		workers.ParallelFor(count, work);
+	}
+
+}
+
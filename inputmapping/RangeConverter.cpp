@@ -9,39 +9,123 @@
 #include "pch.h"
 
 #include "RangeConverter.h"
+#include "InputIdentifiers.h"
 #include "FileIO.h"
 
-#include <fstream>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INPUTMAPPING_USE_SSE2
+#include <emmintrin.h>
+#endif
 
 
 using namespace InputMapping;
 
 
 //
-// Construct the converter and load the conversion table provided
+// Retrieve a conversion which leaves values untouched
 //
-RangeConverter::RangeConverter(std::wifstream& infile)
+RangeConversion RangeConverter::GetIdentityConversion()
 {
-	if(!infile)
-		throw std::exception("Invalid file provided to RangeConverter constructor");
+	RangeConversion conversion;
+	conversion.MinimumInput = -std::numeric_limits<double>::max();
+	conversion.MaximumInput = std::numeric_limits<double>::max();
+	conversion.Scale = 1.0;
+	conversion.Offset = 0.0;
+	return conversion;
+}
 
+//
+// Load a list of conversions from a context file into a conversion table
+//
+// Ranges which are not listed are left as they were.
+//
+void RangeConverter::LoadConversions(TextFileReader& infile, const InputIdentifierTable& identifiers, RangeConversion* conversions)
+{
 	unsigned numconversions = AttemptRead<unsigned>(infile);
 	for(unsigned i = 0; i < numconversions; ++i)
 	{
-		Range range;
-		Converter converter;
+		unsigned range = ReadInputIdentifier(infile, identifiers, INPUT_IDENTIFIER_RANGE);
+		double minimuminput = AttemptRead<double>(infile);
+		double maximuminput = AttemptRead<double>(infile);
+		double minimumoutput = AttemptRead<double>(infile);
+		double maximumoutput = AttemptRead<double>(infile);
+
+		if((maximuminput < minimuminput) || (maximumoutput < minimumoutput))
+			throw std::runtime_error("Invalid input range conversion");
 
-		range = static_cast<Range>(AttemptRead<unsigned>(infile));
-		converter.MinimumInput = AttemptRead<double>(infile);
-		converter.MaximumInput = AttemptRead<double>(infile);
-		converter.MinimumOutput = AttemptRead<double>(infile);
-		converter.MaximumOutput = AttemptRead<double>(infile);
+		// Fold the interpolation into a single multiply-add; a degenerate
+		// input range simply pins the output to its minimum
+		RangeConversion& conversion = conversions[range];
+		conversion.MinimumInput = minimuminput;
+		conversion.MaximumInput = maximuminput;
+		conversion.Scale = (maximuminput > minimuminput) ? (maximumoutput - minimumoutput) / (maximuminput - minimuminput) : 0.0;
+		conversion.Offset = minimumoutput - (minimuminput * conversion.Scale);
+	}
+}
 
-		if((converter.MaximumInput < converter.MinimumInput) || (converter.MaximumOutput < converter.MinimumOutput))
-			throw std::exception("Invalid input range conversion");
 
-		ConversionMap.insert(std::make_pair(range, converter));
+//
+// Construct a batch in which every range is staged as an identity conversion of zero
+//
+RangeConversionBatch::RangeConversionBatch()
+{
+	RangeConversion identity = RangeConverter::GetIdentityConversion();
+
+	for(unsigned i = 0; i < Width; ++i)
+	{
+		RawValues[i] = 0.0;
+		Sensitivities[i] = 1.0;
+		MinimumInputs[i] = identity.MinimumInput;
+		MaximumInputs[i] = identity.MaximumInput;
+		Scales[i] = identity.Scale;
+		Offsets[i] = identity.Offset;
 	}
 }
 
+//
+// Convert every staged range in one pass
+//
+// The output array must have room for RANGE_COUNT values.
+//
+void RangeConversionBatch::ConvertAll(double* outvalues) const
+{
+	unsigned i = 0;
+
+#if defined(__AVX__)
+	for(; i + 4 <= RANGE_COUNT; i += 4)
+	{
+		__m256d v = _mm256_mul_pd(_mm256_loadu_pd(RawValues + i), _mm256_loadu_pd(Sensitivities + i));
+		v = _mm256_max_pd(v, _mm256_loadu_pd(MinimumInputs + i));
+		v = _mm256_min_pd(v, _mm256_loadu_pd(MaximumInputs + i));
+		v = _mm256_add_pd(_mm256_mul_pd(v, _mm256_loadu_pd(Scales + i)), _mm256_loadu_pd(Offsets + i));
+		_mm256_storeu_pd(outvalues + i, v);
+	}
+#elif defined(INPUTMAPPING_USE_SSE2)
+	for(; i + 2 <= RANGE_COUNT; i += 2)
+	{
+		__m128d v = _mm_mul_pd(_mm_loadu_pd(RawValues + i), _mm_loadu_pd(Sensitivities + i));
+		v = _mm_max_pd(v, _mm_loadu_pd(MinimumInputs + i));
+		v = _mm_min_pd(v, _mm_loadu_pd(MaximumInputs + i));
+		v = _mm_add_pd(_mm_mul_pd(v, _mm_loadu_pd(Scales + i)), _mm_loadu_pd(Offsets + i));
+		_mm_storeu_pd(outvalues + i, v);
+	}
+#endif
+
+	// Scalar fallback, and the tail of any vectorized pass; the comparison
+	// is written so a NaN clamps to the minimum, as max_pd does above
+	for(; i < RANGE_COUNT; ++i)
+	{
+		double v = RawValues[i] * Sensitivities[i];
+		if(!(v >= MinimumInputs[i]))
+			v = MinimumInputs[i];
+		else if(v > MaximumInputs[i])
+			v = MaximumInputs[i];
+
+		outvalues[i] = (v * Scales[i]) + Offsets[i];
+	}
+}
 
@@ -10,62 +10,128 @@
 
 
 // Dependencies
-#include <map>
 #include "InputConstants.h"
 
 
+// Forward declarations
+class TextFileReader;
+
+
 namespace InputMapping
 {
 
-	class RangeConverter
+	// Forward declarations
+	class InputIdentifierTable;
+
+
+	//
+	// Linear conversion applied to a single range
+	//
+	// Raw values are clamped to [MinimumInput, MaximumInput] and then mapped
+	// onto the output range with a single multiply-add. Ranges which have no
+	// converter use unbounded input limits and an identity scale. A NaN input
+	// clamps to MinimumInput, matching the vectorized batch conversion.
+	//
+	struct RangeConversion
 	{
-	// Internal helpers
-	private:
-		struct Converter
+		double MinimumInput;
+		double MaximumInput;
+
+		double Scale;
+		double Offset;
+
+		template <typename RangeType>
+		RangeType Convert(RangeType invalue) const
 		{
-			double MinimumInput;
-			double MaximumInput;
-
-			double MinimumOutput;
-			double MaximumOutput;
-
-			template <typename RangeType>
-			RangeType Convert(RangeType invalue) const
-			{
-				double v = static_cast<double>(invalue);
-				if(v < MinimumInput)
-					v = MinimumInput;
-				else if(v > MaximumInput)
-					v = MaximumInput;
-
-				double interpolationfactor = (v - MinimumInput) / (MaximumInput - MinimumInput);
-				return static_cast<RangeType>((interpolationfactor * (MaximumOutput - MinimumOutput)) + MinimumOutput);
-			}
-		};
-
-	// Internal type shortcuts
-	private:
-		typedef std::map<Range, Converter> ConversionMapT;
+			double v = static_cast<double>(invalue);
+			if(!(v >= MinimumInput))
+				v = MinimumInput;
+			else if(v > MaximumInput)
+				v = MaximumInput;
+
+			return static_cast<RangeType>((v * Scale) + Offset);
+		}
+	};
+
 
+	//
+	// View over a context's table of range conversions
+	//
+	class RangeConverter
+	{
 	// Construction
 	public:
-		explicit RangeConverter(std::wifstream& infile);
+		explicit RangeConverter(const RangeConversion* conversions)
+			: Conversions(conversions)
+		{
+		}
+
+	// Loading helpers
+	public:
+		static RangeConversion GetIdentityConversion();
+		static void LoadConversions(TextFileReader& infile, const InputIdentifierTable& identifiers, RangeConversion* conversions);
 
 	// Conversion interface
 	public:
 		template <typename RangeType>
 		RangeType Convert(Range rangeid, RangeType invalue) const
 		{
-			ConversionMapT::const_iterator iter = ConversionMap.find(rangeid);
-			if(iter == ConversionMap.end())
-				return invalue;
+			return Conversions[rangeid].Convert<RangeType>(invalue);
+		}
+
+		const RangeConversion& GetConversion(Range rangeid) const
+		{ return Conversions[rangeid]; }
+
+	// Internal tracking
+	private:
+		const RangeConversion* Conversions;
+	};
+
 
-			return iter->second.Convert<RangeType>(invalue);
+	//
+	// Structure-of-arrays staging area for converting all ranges at once
+	//
+	// Raw range values are staged along with the sensitivity and conversion
+	// that apply to them as input arrives, and then every range is converted
+	// in a single pass per tick. When the build targets SSE2 or AVX the pass
+	// processes two or four ranges per instruction; otherwise a plain scalar
+	// loop is used.
+	//
+	class RangeConversionBatch
+	{
+	// Construction
+	public:
+		RangeConversionBatch();
+
+	// Batch interface
+	public:
+		void Stage(Range range, double rawvalue, double sensitivity, const RangeConversion& conversion)
+		{
+			RawValues[range] = rawvalue;
+			Sensitivities[range] = sensitivity;
+			MinimumInputs[range] = conversion.MinimumInput;
+			MaximumInputs[range] = conversion.MaximumInput;
+			Scales[range] = conversion.Scale;
+			Offsets[range] = conversion.Offset;
 		}
 
+		void ConvertAll(double* outvalues) const;
+
+	// Internal constants
+	private:
+		// Arrays are padded to a whole number of 256-bit vectors; the
+		// vector loads tolerate misalignment, since the batch may live
+		// inside heap objects which don't honor extended alignment
+		static const unsigned Width = (RANGE_COUNT + 3) & ~3u;
+
 	// Internal tracking
 	private:
-		ConversionMapT ConversionMap;
+		alignas(32) double RawValues[Width];
+		alignas(32) double Sensitivities[Width];
+		alignas(32) double MinimumInputs[Width];
+		alignas(32) double MaximumInputs[Width];
+		alignas(32) double Scales[Width];
+		alignas(32) double Offsets[Width];
 	};
 
 }
@@ -24,12 +24,16 @@ namespace InputMapping
 		RAW_INPUT_BUTTON_EIGHT,
 		RAW_INPUT_BUTTON_NINE,
 		RAW_INPUT_BUTTON_ZERO,
+
+		RAW_INPUT_BUTTON_COUNT
 	};
 
 	enum RawInputAxis
 	{
 		RAW_INPUT_AXIS_MOUSE_X,
 		RAW_INPUT_AXIS_MOUSE_Y,
+
+		RAW_INPUT_AXIS_COUNT
 	};
 
 }
@@ -0,0 +1,146 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Lock-free queue for handing raw input events from an input thread to the mapper
+//
+
+#pragma once
+
+
+// Dependencies
+#include "RawInputConstants.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+
+namespace InputMapping
+{
+
+	// Handy type shortcuts
+	typedef unsigned long long InputTimestamp;		// Microseconds on a steady clock
+
+
+	//
+	// Retrieve the current time on the clock used to stamp raw input events
+	//
+	inline InputTimestamp GetInputTimestamp()
+	{
+		return static_cast<InputTimestamp>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+
+	//
+	// Record describing a single raw input event as delivered by the OS/hardware layer
+	//
+	struct RawInputEvent
+	{
+		enum EventType
+		{
+			EVENT_BUTTON,
+			EVENT_AXIS,
+		};
+
+		EventType Type;
+		InputTimestamp Timestamp;
+
+		RawInputButton Button;
+		bool Pressed;
+		bool PreviouslyPressed;
+
+		RawInputAxis Axis;
+		double Value;
+	};
+
+
+	//
+	// Single-producer, single-consumer ring buffer of raw input events
+	//
+	// Exactly one thread may push events and exactly one (possibly different)
+	// thread may read them; no locks are taken on either side. The consumer is
+	// expected to take everything available in one batch: it reads the write
+	// position once, walks the events in place, and then releases them all at
+	// once, so each batch costs a single pair of atomic operations.
+	//
+	class RawInputQueue
+	{
+	// Construction
+	public:
+		explicit RawInputQueue(size_t capacity)
+			: Events(RoundUpToPowerOfTwo(capacity)),
+			  Mask(Events.size() - 1),
+			  WritePosition(0),
+			  ReadPosition(0)
+		{
+		}
+
+	// Producer interface
+	public:
+		//
+		// Append an event to the queue; fails if the consumer has fallen a full buffer behind
+		//
+		bool Push(const RawInputEvent& event)
+		{
+			size_t write = WritePosition.load(std::memory_order_relaxed);
+			if(write - ReadPosition.load(std::memory_order_acquire) > Mask)
+				return false;
+
+			Events[write & Mask] = event;
+			WritePosition.store(write + 1, std::memory_order_release);
+			return true;
+		}
+
+	// Consumer interface
+	public:
+		//
+		// Number of events that have been published and not yet consumed
+		//
+		size_t GetAvailable() const
+		{
+			return WritePosition.load(std::memory_order_acquire) - ReadPosition.load(std::memory_order_relaxed);
+		}
+
+		//
+		// Access the event at a given offset from the read position
+		//
+		// Only valid for offsets less than a count previously returned by GetAvailable().
+		//
+		const RawInputEvent& Peek(size_t offset) const
+		{
+			return Events[(ReadPosition.load(std::memory_order_relaxed) + offset) & Mask];
+		}
+
+		//
+		// Hand a number of consumed events back to the producer
+		//
+		void Consume(size_t count)
+		{
+			ReadPosition.store(ReadPosition.load(std::memory_order_relaxed) + count, std::memory_order_release);
+		}
+
+	// Internal helpers
+	private:
+		static size_t RoundUpToPowerOfTwo(size_t value)
+		{
+			size_t ret = 2;
+			while(ret < value)
+				ret <<= 1;
+			return ret;
+		}
+
+	// Internal tracking
+	private:
+		std::vector<RawInputEvent> Events;
+		const size_t Mask;
+
+		// Producer and consumer positions live on separate cache lines so the
+		// two threads don't fight over ownership of a single line
+		alignas(64) std::atomic<size_t> WritePosition;
+		alignas(64) std::atomic<size_t> ReadPosition;
+	};
+
+}
+
@@ -0,0 +1,343 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Self-check of recording input part way through a session and replaying it
+//
+// Usage: RecordingCheck
+//
+// Writes its own pair of contexts, with combos, modifier bindings, and
+// smoothing filters, into the working directory. A fixed pseudo-random
+// stream of raw input is fed to a mapper until it is holding buttons, part
+// way through a combo, and smoothing its ranges; recording then starts,
+// and the session carries on with contexts pushed and popped and raw axis
+// settings changed. The recording is saved, loaded again, and replayed into
+// a fresh mapper. The program fails unless every tick the replay maps
+// matches the original bit for bit, along with the raw samples it kept.
+//
+
+#include "InputMapper.h"
+#include "InputRecording.h"
+#include "ContextLibrary.h"
+#include "InputConstants.h"
+#include "RawInputConstants.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+
+using namespace InputMapping;
+
+
+//
+// Constants
+//
+namespace
+{
+	const char ContextListFileName[] = "RecordingCheckContexts.txt";
+	const char BaseContextFileName[] = "RecordingCheckBase.txt";
+	const char OverlayContextFileName[] = "RecordingCheckOverlay.txt";
+	const char RecordingFileName[] = "RecordingCheck.imr";
+
+	const unsigned WarmupTicks = 200;
+	const unsigned RecordedTicks = 2000;
+	const InputTimestamp TickMicroseconds = 10000;
+
+	// The base context's combo runs FOUR, FIVE, FOUR; warm-up ends with
+	// FOUR pressed and TWO (a state) held, so recording starts mid-combo
+	const RawInputButton StateButton = RAW_INPUT_BUTTON_TWO;
+	const RawInputButton ComboFirstButton = RAW_INPUT_BUTTON_FOUR;
+	const RawInputButton ComboSecondButton = RAW_INPUT_BUTTON_FIVE;
+
+	// Buttons the random stream presses; the last two belong to the overlay
+	const unsigned StreamButtonCount = 7;
+}
+
+
+//
+// Internal helpers
+//
+namespace
+{
+	//
+	// Small deterministic generator, so every run checks the same stream
+	//
+	class Random
+	{
+	public:
+		explicit Random(unsigned seed)
+			: State(seed)
+		{
+		}
+
+		unsigned Next(unsigned bound)
+		{
+			State = State * 6364136223846793005ull + 1442695040888963407ull;
+			return static_cast<unsigned>((State >> 33) % bound);
+		}
+
+	private:
+		unsigned long long State;
+	};
+
+	//
+	// Write both context files and the list naming them
+	//
+	// The overlay takes over the second axis with a filter chain of its own,
+	// so pushing and popping it hands RANGE_TWO between chains.
+	//
+	void WriteContextFiles()
+	{
+		std::ofstream listfile(ContextListFileName);
+		listfile << "2\n";
+		listfile << "base " << BaseContextFileName << "\n";
+		listfile << "overlay " << OverlayContextFileName << "\n";
+
+		std::ofstream basefile(BaseContextFileName);
+		basefile << "2\n0 RANGE_ONE\n1 RANGE_TWO\n";
+		basefile << "2\n0 STATE_ONE\n1 STATE_TWO\n";
+		basefile << "3\n2 ACTION_ONE\n3 ACTION_TWO\n4 ACTION_THREE\n";
+		basefile << "2\nRANGE_ONE -1000 1000 -1 1\nRANGE_TWO -1000 1000 -1 1\n";
+		basefile << "0\n";
+		basefile << "2\nRANGE_ONE 2 0.75\nRANGE_TWO 2 0.5\n";
+		basefile << "2\nACTION_SEVEN 500 3 3 4 3\nACTION_SIX 300 2 0+2 4\n";
+		basefile << "1\n2 0 - action ACTION_FOUR\n";
+
+		std::ofstream overlayfile(OverlayContextFileName);
+		overlayfile << "1\n1 RANGE_TWO\n";
+		overlayfile << "1\n6 STATE_THREE\n";
+		overlayfile << "1\n5 ACTION_ONE\n";
+		overlayfile << "1\nRANGE_TWO -1000 1000 -1 1\n";
+		overlayfile << "0\n";
+		overlayfile << "1\nRANGE_TWO 2 0.9\n";
+		overlayfile << "1\nACTION_FIVE 400 2 5 6\n";
+	}
+
+	void RemoveContextFiles()
+	{
+		std::remove(ContextListFileName);
+		std::remove(BaseContextFileName);
+		std::remove(OverlayContextFileName);
+		std::remove(RecordingFileName);
+	}
+
+	std::wstring WideFileName(const char* filename)
+	{
+		return std::wstring(filename, filename + std::strlen(filename));
+	}
+
+	//
+	// Feed a button change through the queue, keeping track of what is held
+	//
+	void SetButton(InputMapper& mapper, bool* held, RawInputButton button, bool pressed, InputTimestamp timestamp)
+	{
+		mapper.QueueRawButtonState(button, pressed, held[button], timestamp);
+		held[button] = pressed;
+	}
+
+	//
+	// Produce one tick of random raw input, then map and dispatch it
+	//
+	void RunTick(InputMapper& mapper, Random& random, bool* held, InputTimestamp timestamp)
+	{
+		unsigned eventcount = random.Next(4);
+		for(unsigned i = 0; i < eventcount; ++i)
+		{
+			InputTimestamp eventtime = timestamp + random.Next(static_cast<unsigned>(TickMicroseconds));
+			if(random.Next(3))
+			{
+				RawInputButton button = static_cast<RawInputButton>(random.Next(StreamButtonCount));
+				SetButton(mapper, held, button, !held[button], eventtime);
+			}
+			else
+				mapper.QueueRawAxisValue(static_cast<RawInputAxis>(random.Next(RAW_INPUT_AXIS_COUNT)), static_cast<double>(random.Next(2001)) - 1000.0, eventtime);
+		}
+
+		mapper.ProcessQueuedInput();
+		mapper.Dispatch();
+		mapper.Clear();
+	}
+
+	//
+	// What a callback saw on one tick: the mapped input, and how many raw
+	// samples of the second axis were kept
+	//
+	struct CapturedTick
+	{
+		MappedInput Input;
+		size_t SampleCount;
+	};
+
+	//
+	// Capture every tick with input from a mapper
+	//
+	void AddCaptureCallback(InputMapper& mapper, std::vector<CapturedTick>& ticks)
+	{
+		InputMapper* source = &mapper;
+		std::vector<CapturedTick>* destination = &ticks;
+		mapper.AddCallback([source, destination](MappedInput& input)
+		{
+			CapturedTick tick;
+			tick.Input = input;
+			tick.SampleCount = source->GetRawAxisSampleCount(RAW_INPUT_AXIS_MOUSE_Y);
+			destination->push_back(tick);
+		}, 0);
+	}
+
+	//
+	// Compare two ticks bit for bit, ignoring values of absent ranges
+	//
+	bool IsSameTick(const CapturedTick& firsttick, const CapturedTick& secondtick)
+	{
+		const MappedInput& first = firsttick.Input;
+		const MappedInput& second = secondtick.Input;
+		if(firsttick.SampleCount != secondtick.SampleCount)
+			return false;
+
+		if(first.Actions != second.Actions || first.States != second.States || first.Ranges != second.Ranges)
+			return false;
+
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+		{
+			if(first.Ranges.test(i) && std::memcmp(&first.RangeValues[i], &second.RangeValues[i], sizeof(double)) != 0)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+
+int main()
+{
+	try
+	{
+		WriteContextFiles();
+		std::shared_ptr<const ContextLibrary> library = ContextLibrary::LoadText(WideFileName(ContextListFileName));
+
+		// Callbacks only run on ticks with input, so every tick holding
+		// anything is captured, in order, from each mapper
+		std::vector<CapturedTick> original;
+		std::vector<CapturedTick> replayed;
+
+		InputMapper mapper(*library);
+		mapper.SetRawAxisMode(RAW_INPUT_AXIS_MOUSE_X, RAW_AXIS_MODE_SUM);
+		mapper.EnableRawAxisSampleHistory(RAW_INPUT_AXIS_MOUSE_Y, 4);
+		mapper.PushContext(L"base");
+		mapper.PushContext(L"overlay");
+		bool overlayactive = true;
+
+		Random random(2011);
+		bool held[RAW_INPUT_BUTTON_COUNT] = { false };
+		InputTimestamp timestamp = GetInputTimestamp();
+
+		for(unsigned tick = 0; tick < WarmupTicks; ++tick, timestamp += TickMicroseconds)
+			RunTick(mapper, random, held, timestamp);
+
+		// Let go of everything, then hold the state and start the combo
+		for(unsigned i = 0; i < RAW_INPUT_BUTTON_COUNT; ++i)
+		{
+			if(held[i])
+				SetButton(mapper, held, static_cast<RawInputButton>(i), false, timestamp);
+		}
+
+		SetButton(mapper, held, StateButton, true, timestamp);
+		SetButton(mapper, held, ComboFirstButton, true, timestamp + 1);
+		mapper.QueueRawAxisValue(RAW_INPUT_AXIS_MOUSE_X, 800.0, timestamp + 2);
+		mapper.QueueRawAxisValue(RAW_INPUT_AXIS_MOUSE_Y, -600.0, timestamp + 3);
+		mapper.ProcessQueuedInput();
+		mapper.Dispatch();
+		mapper.Clear();
+		timestamp += TickMicroseconds;
+
+		InputRecording recording;
+		mapper.StartRecording(recording);
+		AddCaptureCallback(mapper, original);
+
+		// Finish the combo; it only fires if recording picked up its progress
+		SetButton(mapper, held, ComboFirstButton, false, timestamp);
+		SetButton(mapper, held, ComboSecondButton, true, timestamp + 1);
+		mapper.ProcessQueuedInput();
+		mapper.Dispatch();
+		mapper.Clear();
+		timestamp += TickMicroseconds;
+
+		SetButton(mapper, held, ComboSecondButton, false, timestamp);
+		SetButton(mapper, held, ComboFirstButton, true, timestamp + 1);
+		mapper.QueueRawAxisValue(RAW_INPUT_AXIS_MOUSE_X, 800.0, timestamp + 2);
+		mapper.QueueRawAxisValue(RAW_INPUT_AXIS_MOUSE_Y, -600.0, timestamp + 3);
+		mapper.ProcessQueuedInput();
+		mapper.Dispatch();
+		mapper.Clear();
+		timestamp += TickMicroseconds;
+
+		for(unsigned tick = 0; tick < RecordedTicks; ++tick, timestamp += TickMicroseconds)
+		{
+			if(tick == RecordedTicks / 2)
+			{
+				mapper.SetRawAxisMode(RAW_INPUT_AXIS_MOUSE_X, RAW_AXIS_MODE_AVERAGE);
+				mapper.EnableRawAxisSampleHistory(RAW_INPUT_AXIS_MOUSE_Y, 0);
+			}
+
+			if(random.Next(100) == 0)
+			{
+				if(overlayactive)
+					mapper.PopContext();
+				else
+					mapper.PushContext(L"overlay");
+
+				overlayactive = !overlayactive;
+			}
+
+			RunTick(mapper, random, held, timestamp);
+		}
+
+		mapper.StopRecording();
+		recording.Save(WideFileName(RecordingFileName));
+
+		InputRecording loaded(WideFileName(RecordingFileName));
+		InputMapper replaymapper(*library);
+		AddCaptureCallback(replaymapper, replayed);
+
+		InputReplayer replayer(loaded);
+		replayer.Replay(replaymapper, INPUT_REPLAY_FULL_SPEED);
+
+		RemoveContextFiles();
+
+		if(original.size() < 2 || !original[1].Input.Actions.test(ACTION_SEVEN))
+		{
+			std::fprintf(stderr, "The combo under way when recording started did not fire\n");
+			return 1;
+		}
+
+		if(replayed.size() != original.size())
+		{
+			std::fprintf(stderr, "Replay mapped input on %u ticks; the original did on %u\n", static_cast<unsigned>(replayed.size()), static_cast<unsigned>(original.size()));
+			return 1;
+		}
+
+		for(size_t i = 0; i < original.size(); ++i)
+		{
+			if(!IsSameTick(original[i], replayed[i]))
+			{
+				std::fprintf(stderr, "Replay differed from the original on tick %u\n", static_cast<unsigned>(i));
+				return 1;
+			}
+		}
+
+		std::printf("Replayed %u ticks (%u bytes recorded); all %u ticks with input matched\n", static_cast<unsigned>(replayer.GetTickCount()), static_cast<unsigned>(loaded.GetData().size()), static_cast<unsigned>(original.size()));
+	}
+	catch(const std::exception& e)
+	{
+		RemoveContextFiles();
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
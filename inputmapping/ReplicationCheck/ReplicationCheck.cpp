@@ -0,0 +1,263 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Self-check of input replication over a lossy loopback connection
+//
+// Usage: ReplicationCheck
+//
+// A fixed pseudo-random stream of mapped input is sent one tick at a time
+// through an InputSender, a pair of InputLoopbackChannels which delay every
+// packet and drop some of them, and an InputReceiver. The receiving end
+// simulates every tick as soon as it comes due, predicting input which has
+// not arrived yet, the way a game would. The program fails unless every
+// tick arrives exactly as it was sent (after quantization), and unless the
+// history reports exactly the earliest tick each time a prediction proves
+// wrong, and nothing when predictions hold.
+//
+
+#include "InputReplication.h"
+#include "MappedInput.h"
+#include "InputConstants.h"
+
+#include <cstdio>
+#include <exception>
+#include <vector>
+
+
+using namespace InputMapping;
+
+
+//
+// Constants
+//
+namespace
+{
+	const unsigned TickCount = 2000;
+
+	// The connection delays packets by this many ticks each way, and loses
+	// every DropInterval'th packet sent in each direction
+	const unsigned Latency = 3;
+	const unsigned DropInterval = 4;
+
+	// Ticks run after the last one is sent, so everything still in flight
+	// (and every packet re-sent to cover a loss) can arrive
+	const unsigned DrainTicks = 8 * (Latency + 1) * DropInterval;
+}
+
+
+//
+// Internal helpers
+//
+namespace
+{
+	//
+	// Small deterministic generator, so every run checks the same stream
+	//
+	class Random
+	{
+	public:
+		explicit Random(unsigned seed)
+			: State(seed)
+		{
+		}
+
+		unsigned Next(unsigned bound)
+		{
+			State = State * 6364136223846793005ull + 1442695040888963407ull;
+			return static_cast<unsigned>((State >> 33) % bound);
+		}
+
+	private:
+		unsigned long long State;
+	};
+
+	//
+	// Produce the next tick of local input from the previous one
+	//
+	// Actions are occasional one-off events, states toggle now and then, and
+	// ranges come and go and move in steps, so some ticks are predicted
+	// correctly and some are not.
+	//
+	MappedInput MakeTick(Random& random, const MappedInput& previous)
+	{
+		MappedInput input = previous;
+		input.Actions.reset();
+
+		if(random.Next(8) == 0)
+			input.SetAction(static_cast<Action>(random.Next(ACTION_COUNT)));
+
+		if(random.Next(16) == 0)
+			input.States.flip(random.Next(STATE_COUNT));
+
+		if(random.Next(12) == 0)
+		{
+			Range range = static_cast<Range>(random.Next(RANGE_BUILTIN_COUNT));
+			if(input.Ranges.test(range) && random.Next(2))
+				input.Ranges.reset(range);
+			else
+				input.SetRange(range, (static_cast<double>(random.Next(2001)) / 1000.0) - 1.0);
+		}
+
+		return input;
+	}
+
+	//
+	// Compare two ticks the way the history does, ignoring values of absent ranges
+	//
+	bool IsSameInput(const MappedInput& first, const MappedInput& second)
+	{
+		if(first.Actions != second.Actions || first.States != second.States || first.Ranges != second.Ranges)
+			return false;
+
+		for(unsigned i = 0; i < RANGE_COUNT; ++i)
+		{
+			if(first.Ranges.test(i) && first.RangeValues[i] != second.RangeValues[i])
+				return false;
+		}
+
+		return true;
+	}
+}
+
+
+int main()
+{
+	try
+	{
+		InputEncoding encoding;
+
+		InputSender sender(encoding);
+		InputHistory history;
+		InputReceiver receiver(encoding, history);
+
+		InputLoopbackChannel forward(Latency, DropInterval);
+		InputLoopbackChannel backward(Latency, DropInterval);
+
+		// What was sent (as quantized), and what the receiving end simulated with
+		std::vector<MappedInput> sent(TickCount);
+		std::vector<MappedInput> simulated(TickCount);
+		std::vector<bool> arrived(TickCount, false);
+
+		Random random(2011);
+		MappedInput local = MappedInput();
+
+		unsigned arrivedcount = 0;
+		unsigned firstmissing = 0;
+		unsigned mispredictions = 0;
+		unsigned packets = 0;
+		size_t bytes = 0;
+
+		std::vector<unsigned char> packet;
+		for(unsigned step = 0; step < TickCount + DrainTicks; ++step)
+		{
+			// Sending end: add this tick, and send everything unacknowledged
+			if(step < TickCount)
+			{
+				local = MakeTick(random, local);
+				sent[step] = local;
+				encoding.Quantize(sent[step]);
+				sender.AddTick(step, local);
+			}
+
+			packet.clear();
+			sender.WritePacket(packet);
+			forward.Send(packet);
+			++packets;
+			bytes += packet.size();
+
+			// Receiving end: take whatever has arrived, and acknowledge it
+			forward.Deliver();
+			while(forward.Receive(packet))
+				receiver.ReadPacket(packet.data(), packet.size());
+
+			packet.clear();
+			if(receiver.WriteAcknowledgementPacket(packet))
+				backward.Send(packet);
+
+			backward.Deliver();
+			while(backward.Receive(packet))
+				sender.ReadAcknowledgementPacket(packet.data(), packet.size());
+
+			// Check every newly arrived tick against what was sent, and work
+			// out the earliest one the simulation got wrong
+			unsigned simulatedcount = (step < TickCount) ? step : TickCount;
+			bool expectmisprediction = false;
+			unsigned expectedtick = 0;
+			for(unsigned tick = firstmissing; tick < simulatedcount; ++tick)
+			{
+				if(arrived[tick])
+					continue;
+
+				const MappedInput* confirmed = history.FindConfirmed(tick);
+				if(!confirmed)
+					continue;
+
+				if(!IsSameInput(*confirmed, sent[tick]))
+				{
+					std::fprintf(stderr, "Tick %u arrived with different input than was sent\n", tick);
+					return 1;
+				}
+
+				arrived[tick] = true;
+				++arrivedcount;
+
+				if(!expectmisprediction && !IsSameInput(*confirmed, simulated[tick]))
+				{
+					expectmisprediction = true;
+					expectedtick = tick;
+				}
+			}
+
+			while(firstmissing < simulatedcount && arrived[firstmissing])
+				++firstmissing;
+
+			unsigned reportedtick;
+			bool reported = history.TakeMisprediction(reportedtick);
+			if(reported != expectmisprediction || (reported && reportedtick != expectedtick))
+			{
+				std::fprintf(stderr, "Step %u: misprediction reported %s tick %u; expected %s tick %u\n", step, reported ? "at" : "not at", reportedtick, expectmisprediction ? "at" : "not at", expectedtick);
+				return 1;
+			}
+
+			// Rewind and re-simulate from the bad tick, then simulate this one
+			if(reported)
+			{
+				++mispredictions;
+				for(unsigned tick = reportedtick; tick < simulatedcount; ++tick)
+					simulated[tick] = history.GetInput(tick);
+			}
+
+			if(step < TickCount)
+				simulated[step] = history.GetInput(step);
+		}
+
+		if(arrivedcount != TickCount)
+		{
+			std::fprintf(stderr, "Only %u of %u ticks arrived\n", arrivedcount, TickCount);
+			return 1;
+		}
+
+		if(sender.GetUnacknowledgedCount())
+		{
+			std::fprintf(stderr, "%u ticks were never acknowledged\n", static_cast<unsigned>(sender.GetUnacknowledgedCount()));
+			return 1;
+		}
+
+		if(!mispredictions)
+		{
+			std::fprintf(stderr, "No mispredictions occurred, so rewinding was never checked\n");
+			return 1;
+		}
+
+		std::printf("Replicated %u ticks in %u packets (%u bytes) with %u-tick latency and 1 in %u packets lost; %u mispredictions reported\n", TickCount, packets, static_cast<unsigned>(bytes), Latency, DropInterval, mispredictions);
+	}
+	catch(const std::exception& e)
+	{
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
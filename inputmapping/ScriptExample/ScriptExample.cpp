@@ -0,0 +1,157 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Example of a C++20 coroutine script driven by mapped input
+//
+// Usage: InputScriptExample [context list]
+//
+// Run from the Build folder, like the demo, so the default context list and
+// its context files are found. A short script waits for ACTION_ONE and then
+// for STATE_TWO to be held, while simulated key presses are fed through the
+// mapper one tick at a time. The program fails if the script does not get
+// through both waits, or gets through them early.
+//
+
+#include "InputMapper.h"
+#include "ContextLibrary.h"
+#include "InputConstants.h"
+#include "RawInputConstants.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <thread>
+
+
+#ifndef INPUTMAPPING_HAS_COROUTINES
+#error The script example must be built as C++20 with coroutine support
+#endif
+
+
+using namespace InputMapping;
+
+
+//
+// Constants
+//
+namespace
+{
+	// Raw buttons which MainContext.txt maps to the inputs the script waits on
+	const RawInputButton ActionOneButton = RAW_INPUT_BUTTON_FOUR;
+	const RawInputButton StateTwoButton = RAW_INPUT_BUTTON_TWO;
+
+	const std::chrono::milliseconds HoldDuration(100);
+	const std::chrono::milliseconds TickDuration(10);
+}
+
+
+//
+// The script under test
+//
+namespace
+{
+	enum ScriptProgress
+	{
+		SCRIPT_STARTED,
+		SCRIPT_SAW_ACTION,
+		SCRIPT_SAW_HOLD
+	};
+
+	ScriptProgress Progress = SCRIPT_STARTED;
+
+	InputScript RunScript(InputMapper& mapper)
+	{
+		co_await mapper.NextAction(ACTION_ONE);
+		Progress = SCRIPT_SAW_ACTION;
+
+		co_await mapper.StateHeldFor(STATE_TWO, HoldDuration);
+		Progress = SCRIPT_SAW_HOLD;
+	}
+}
+
+
+//
+// Internal helpers
+//
+namespace
+{
+	void Tick(InputMapper& mapper)
+	{
+		mapper.Dispatch();
+		mapper.Clear();
+		std::this_thread::sleep_for(TickDuration);
+	}
+
+	bool Expect(ScriptProgress expected, const char* when)
+	{
+		if(Progress == expected)
+			return true;
+
+		std::fprintf(stderr, "Script reached stage %d %s; expected stage %d\n", Progress, when, expected);
+		return false;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	const char* contextlist = (argc > 1) ? argv[1] : "ContextList.txt";
+
+	try
+	{
+		std::shared_ptr<const ContextLibrary> library = ContextLibrary::LoadText(std::wstring(contextlist, contextlist + std::strlen(contextlist)));
+		InputMapper mapper(*library);
+		mapper.PushContext(L"maincontext");
+
+		RunScript(mapper);
+
+		// A tick with nothing pressed must not wake the script
+		Tick(mapper);
+		if(!Expect(SCRIPT_STARTED, "with no input"))
+			return 1;
+
+		mapper.SetRawButtonState(ActionOneButton, true, false);
+		Tick(mapper);
+		mapper.SetRawButtonState(ActionOneButton, false, true);
+		if(!Expect(SCRIPT_SAW_ACTION, "after the action fired"))
+			return 1;
+
+		// Hold the state for half the duration, release it, and hold it
+		// again; the release must restart the hold
+		mapper.SetRawButtonState(StateTwoButton, true, false);
+		std::chrono::steady_clock::time_point held = std::chrono::steady_clock::now();
+		while(std::chrono::steady_clock::now() - held < HoldDuration / 2)
+			Tick(mapper);
+
+		mapper.SetRawButtonState(StateTwoButton, false, true);
+		Tick(mapper);
+		if(!Expect(SCRIPT_SAW_ACTION, "after a short hold"))
+			return 1;
+
+		mapper.SetRawButtonState(StateTwoButton, true, false);
+		held = std::chrono::steady_clock::now();
+		while(Progress != SCRIPT_SAW_HOLD && std::chrono::steady_clock::now() - held < HoldDuration * 4)
+			Tick(mapper);
+
+		if(!Expect(SCRIPT_SAW_HOLD, "while the state was held"))
+			return 1;
+
+		if(std::chrono::steady_clock::now() - held < HoldDuration)
+		{
+			std::fprintf(stderr, "Script resumed before the state had been held long enough\n");
+			return 1;
+		}
+	}
+	catch(const std::exception& e)
+	{
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+
+	std::printf("Script waited for ACTION_ONE and a %d ms hold of STATE_TWO\n", static_cast<int>(HoldDuration.count()));
+	return 0;
+}
@@ -0,0 +1,113 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Stack container which keeps its first few entries inline
+//
+
+#pragma once
+
+
+// Dependencies
+#include <cstddef>
+
+
+namespace InputMapping
+{
+
+	//
+	// Stack of plain values with inline storage for the common case
+	//
+	// Up to InlineCapacity entries live inside the object itself, so pushing
+	// and popping never touches the heap until the stack grows deeper than
+	// that. Beyond that point storage doubles as needed and is kept for the
+	// lifetime of the stack, so only the first trip to a new depth allocates.
+	// Entries are copied by assignment, so this is intended for small, plain
+	// data types.
+	//
+	template <typename T, size_t InlineCapacity>
+	class SmallStack
+	{
+	// Construction and destruction
+	public:
+		SmallStack()
+			: Entries(InlineEntries),
+			  Count(0),
+			  Capacity(InlineCapacity)
+		{
+		}
+
+		~SmallStack()
+		{
+			if(Entries != InlineEntries)
+				delete [] Entries;
+		}
+
+	// Stack interface
+	public:
+		void Push(const T& value)
+		{
+			if(Count == Capacity)
+				Grow();
+
+			Entries[Count++] = value;
+		}
+
+		void Pop()
+		{ --Count; }
+
+		void Truncate(size_t count)
+		{
+			if(count < Count)
+				Count = count;
+		}
+
+		T& Back()
+		{ return Entries[Count - 1]; }
+
+		const T& Back() const
+		{ return Entries[Count - 1]; }
+
+		T& operator [] (size_t index)
+		{ return Entries[index]; }
+
+		const T& operator [] (size_t index) const
+		{ return Entries[index]; }
+
+		size_t GetCount() const
+		{ return Count; }
+
+		bool IsEmpty() const
+		{ return Count == 0; }
+
+	// Internal helpers
+	private:
+		void Grow()
+		{
+			T* grown = new T[Capacity * 2];
+			for(size_t i = 0; i < Count; ++i)
+				grown[i] = Entries[i];
+
+			if(Entries != InlineEntries)
+				delete [] Entries;
+
+			Entries = grown;
+			Capacity *= 2;
+		}
+
+	// Copy semantics are not supported
+	private:
+		SmallStack(const SmallStack&);
+		SmallStack& operator = (const SmallStack&);
+
+	// Internal tracking
+	private:
+		T InlineEntries[InlineCapacity];
+		T* Entries;
+		size_t Count;
+		size_t Capacity;
+	};
+
+}
+
@@ -0,0 +1,96 @@
+//
+// Input Mapping Demo
+// By Mike Lewis, June 2011
+// http://scribblings-by-apoch.googlecode.com/
+//
+// Input contexts whose bindings are fixed at compile time
+//
+
+#pragma once
+
+
+// Dependencies
+#include "RawInputConstants.h"
+#include "InputConstants.h"
+#include "InputBindings.h"
+#include "RangeConverter.h"
+#include "ContextTables.h"
+
+
+namespace InputMapping
+{
+
+	//
+	// Input context with bindings known at compile time
+	//
+	// The definition type supplies the context's tables as a constexpr
+	// member named Tables; such definitions are normally generated from
+	// the text context files with "ContextCompiler -header". This exposes
+	// the same mapping interface as InputContext, but every lookup is a
+	// constant expression, so when the raw input is known at the call site
+	// the compiler can fold the whole mapping step away.
+	//
+	// To use a static context with an InputMapper, construct an ordinary
+	// InputContext from GetTables(); the tables are then used in place,
+	// with no parsing or copying.
+	//
+	template <typename Definition>
+	class StaticInputContext
+	{
+	// Mapping interface
+	public:
+		static constexpr bool MapButtonToAction(RawInputButton button, Action& out)
+		{
+			unsigned short action = Definition::Tables.Buttons[button].MappedAction;
+			if(action == UnmappedBinding)
+				return false;
+
+			out = static_cast<Action>(action);
+			return true;
+		}
+
+		static constexpr bool MapButtonToState(RawInputButton button, State& out)
+		{
+			unsigned short state = Definition::Tables.Buttons[button].MappedState;
+			if(state == UnmappedBinding)
+				return false;
+
+			out = static_cast<State>(state);
+			return true;
+		}
+
+		static constexpr bool MapAxisToRange(RawInputAxis axis, Range& out)
+		{
+			unsigned short range = Definition::Tables.Axes[axis];
+			if(range == UnmappedBinding)
+				return false;
+
+			out = static_cast<Range>(range);
+			return true;
+		}
+
+		static constexpr double GetSensitivity(Range range)
+		{ return Definition::Tables.Sensitivities[range]; }
+
+		static RangeConverter GetConversions()
+		{ return RangeConverter(Definition::Tables.Conversions); }
+
+	// Compile-time query interface
+	public:
+		static constexpr bool IsButtonMappedToAction(RawInputButton button, Action action)
+		{ return Definition::Tables.Buttons[button].MappedAction == static_cast<unsigned short>(action); }
+
+		static constexpr bool IsButtonMappedToState(RawInputButton button, State state)
+		{ return Definition::Tables.Buttons[button].MappedState == static_cast<unsigned short>(state); }
+
+		static constexpr bool IsAxisMappedToRange(RawInputAxis axis, Range range)
+		{ return Definition::Tables.Axes[axis] == static_cast<unsigned short>(range); }
+
+	// Compilation interface
+	public:
+		static constexpr const ContextTables& GetTables()
+		{ return Definition::Tables; }
+	};
+
+}
+